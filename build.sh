@@ -9,19 +9,55 @@ BUILD_DIR="$PROJECT_ROOT/build_bash"
 
 CXX=g++
 CXX_STANDARD="-std=c++17"
+# Plain -O2; CMakeLists.txt has the tuned builds (LTO, PGO, -march=native)
+OPT_FLAGS="-O2"
+THREAD_FLAGS="-pthread"
 
 # Source files for video_cleaner
 APP_SOURCES="$SRC_DIR/main.cpp \
              $SRC_DIR/filters.cpp \
+             $SRC_DIR/fft.cpp \
+             $SRC_DIR/convolution.cpp \
+             $SRC_DIR/fir_kernel.cpp \
+             $SRC_DIR/thread_pool.cpp \
+             $SRC_DIR/frame_pool.cpp \
+             $SRC_DIR/pipeline_stats.cpp \
+             $SRC_DIR/media_demuxer.cpp \
+             $SRC_DIR/media_muxer.cpp \
              $SRC_DIR/process.cpp \
              $SRC_DIR/video_denoise.cpp"
 
+# Source files for video_cleaner_bench (DSP only, no OpenCV/FFmpeg)
+BENCH_SOURCES="$SRC_DIR/dsp_bench.cpp \
+               $SRC_DIR/filters.cpp \
+               $SRC_DIR/fft.cpp \
+               $SRC_DIR/convolution.cpp \
+               $SRC_DIR/fir_kernel.cpp \
+               $SRC_DIR/pipeline_stats.cpp \
+               $SRC_DIR/thread_pool.cpp"
+
+# Source files for video_pipeline_bench (the e2e mode runs the full VideoProcessor)
+VIDEO_BENCH_SOURCES="$SRC_DIR/video_bench.cpp \
+                     $SRC_DIR/filters.cpp \
+                     $SRC_DIR/fft.cpp \
+                     $SRC_DIR/convolution.cpp \
+                     $SRC_DIR/fir_kernel.cpp \
+                     $SRC_DIR/thread_pool.cpp \
+                     $SRC_DIR/frame_pool.cpp \
+                     $SRC_DIR/pipeline_stats.cpp \
+                     $SRC_DIR/media_demuxer.cpp \
+                     $SRC_DIR/media_muxer.cpp \
+                     $SRC_DIR/process.cpp \
+                     $SRC_DIR/video_denoise.cpp"
+
 # Source file for face_extractor
 FACE_EXTRACTOR_SRC="$SRC_DIR/face_extractor.cpp"
 
 # Output executable names
 APP_EXECUTABLE="$BUILD_DIR/video_cleaner"
 FACE_EXTRACTOR_EXECUTABLE="$BUILD_DIR/face_extractor"
+BENCH_EXECUTABLE="$BUILD_DIR/video_cleaner_bench"
+VIDEO_BENCH_EXECUTABLE="$BUILD_DIR/video_pipeline_bench"
 
 # Create build directory
 mkdir -p "$BUILD_DIR"
@@ -44,8 +80,8 @@ echo "OpenCV CFLAGS: $OPENCV_CFLAGS"
 echo "OpenCV LIBS: $OPENCV_LIBS"
 
 echo "Fetching FFmpeg flags..."
-FFMPEG_CFLAGS=$(pkg-config --cflags libavcodec libavformat libavutil libswresample)
-FFMPEG_LIBS=$(pkg-config --libs libavcodec libavformat libavutil libswresample)
+FFMPEG_CFLAGS=$(pkg-config --cflags libavcodec libavformat libavutil libswresample libswscale)
+FFMPEG_LIBS=$(pkg-config --libs libavcodec libavformat libavutil libswresample libswscale)
 if [ -z "$FFMPEG_LIBS" ]; then
     echo "Error: Could not get FFmpeg linker flags (FFMPEG_LIBS) using pkg-config. Please ensure FFmpeg development libraries are installed."
     exit 1
@@ -64,21 +100,51 @@ for src_file in $APP_SOURCES; do
     base_name=$(basename "$src_file" .cpp)
     obj_file="$BUILD_DIR/${base_name}.o"
     echo "Compiling $src_file -> $obj_file"
-    $CXX $CXX_STANDARD $INCLUDE_PATHS $OPENCV_CFLAGS $FFMPEG_CFLAGS -c "$src_file" -o "$obj_file"
+    $CXX $CXX_STANDARD $OPT_FLAGS $THREAD_FLAGS $INCLUDE_PATHS $OPENCV_CFLAGS $FFMPEG_CFLAGS -c "$src_file" -o "$obj_file"
     APP_OBJECTS="$APP_OBJECTS $obj_file"
 done
 
 echo "Linking $APP_EXECUTABLE..."
-$CXX $APP_OBJECTS $OPENCV_LIBS $FFMPEG_LIBS -o "$APP_EXECUTABLE"
+$CXX $THREAD_FLAGS $APP_OBJECTS $OPENCV_LIBS $FFMPEG_LIBS -o "$APP_EXECUTABLE"
 echo "video_cleaner built successfully: $APP_EXECUTABLE"
 
 # --- Build face_extractor ---
 echo "Building face_extractor..."
 echo "Compiling $FACE_EXTRACTOR_SRC -> $BUILD_DIR/face_extractor.o"
-$CXX $CXX_STANDARD $INCLUDE_PATHS $OPENCV_CFLAGS -c "$FACE_EXTRACTOR_SRC" -o "$BUILD_DIR/face_extractor.o"
+$CXX $CXX_STANDARD $OPT_FLAGS $THREAD_FLAGS $INCLUDE_PATHS $OPENCV_CFLAGS -c "$FACE_EXTRACTOR_SRC" -o "$BUILD_DIR/face_extractor.o"
 
 echo "Linking $FACE_EXTRACTOR_EXECUTABLE..."
-$CXX "$BUILD_DIR/face_extractor.o" $OPENCV_LIBS -o "$FACE_EXTRACTOR_EXECUTABLE"
+$CXX $THREAD_FLAGS "$BUILD_DIR/face_extractor.o" $OPENCV_LIBS -o "$FACE_EXTRACTOR_EXECUTABLE"
 echo "face_extractor built successfully: $FACE_EXTRACTOR_EXECUTABLE"
 
+# --- Build video_cleaner_bench ---
+echo "Building video_cleaner_bench..."
+BENCH_OBJECTS=""
+for src_file in $BENCH_SOURCES; do
+    base_name=$(basename "$src_file" .cpp)
+    obj_file="$BUILD_DIR/bench_${base_name}.o"
+    echo "Compiling $src_file -> $obj_file"
+    $CXX $CXX_STANDARD $OPT_FLAGS $THREAD_FLAGS $INCLUDE_PATHS -c "$src_file" -o "$obj_file"
+    BENCH_OBJECTS="$BENCH_OBJECTS $obj_file"
+done
+
+echo "Linking $BENCH_EXECUTABLE..."
+$CXX $THREAD_FLAGS $BENCH_OBJECTS -o "$BENCH_EXECUTABLE"
+echo "video_cleaner_bench built successfully: $BENCH_EXECUTABLE"
+
+# --- Build video_pipeline_bench ---
+echo "Building video_pipeline_bench..."
+VIDEO_BENCH_OBJECTS=""
+for src_file in $VIDEO_BENCH_SOURCES; do
+    base_name=$(basename "$src_file" .cpp)
+    obj_file="$BUILD_DIR/video_bench_${base_name}.o"
+    echo "Compiling $src_file -> $obj_file"
+    $CXX $CXX_STANDARD $OPT_FLAGS $THREAD_FLAGS $INCLUDE_PATHS $OPENCV_CFLAGS $FFMPEG_CFLAGS -c "$src_file" -o "$obj_file"
+    VIDEO_BENCH_OBJECTS="$VIDEO_BENCH_OBJECTS $obj_file"
+done
+
+echo "Linking $VIDEO_BENCH_EXECUTABLE..."
+$CXX $THREAD_FLAGS $VIDEO_BENCH_OBJECTS $OPENCV_LIBS $FFMPEG_LIBS -o "$VIDEO_BENCH_EXECUTABLE"
+echo "video_pipeline_bench built successfully: $VIDEO_BENCH_EXECUTABLE"
+
 echo "Build complete!" 
\ No newline at end of file
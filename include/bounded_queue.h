@@ -0,0 +1,145 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * Fixed-capacity FIFO shared between pipeline threads
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * Constructor
+     * @param capacity Maximum number of queued items
+     */
+    explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+    /**
+     * Appends an item, blocking while the queue is full
+     * @param item Item to append
+     * @return False if the queue was closed
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * Removes the oldest item, blocking while the queue is empty
+     * @param item Receives the removed item
+     * @return False once the queue is closed and drained
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * Closes the queue; pending items can still be popped
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+private:
+    size_t m_capacity;
+    bool m_closed = false;
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+};
+
+/**
+ * Restores sequence order of items completed out of order
+ *
+ * Only items within `capacity` of the next expected index are accepted,
+ * so a slow item holds back at most `capacity` finished ones.
+ */
+template <typename T>
+class ReorderBuffer {
+public:
+    /**
+     * Constructor
+     * @param capacity Maximum distance ahead of the next expected index
+     */
+    explicit ReorderBuffer(size_t capacity) : m_slots(capacity > 0 ? capacity : 1) {}
+
+    /**
+     * Stores an item, blocking while it is too far ahead
+     * @param index Sequence index of the item
+     * @param item Item to store
+     * @return False if the buffer was closed
+     */
+    bool push(size_t index, T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_canPush.wait(lock, [&] { return m_closed || index < m_next + m_slots.size(); });
+        if (m_closed) {
+            return false;
+        }
+        m_slots[index % m_slots.size()] = std::move(item);
+        if (index == m_next) {
+            m_canPop.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Removes the next item in sequence, blocking until it arrives
+     * @param item Receives the item
+     * @return False once closed and the next item is not available
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto& slot = m_slots[m_next % m_slots.size()];
+        m_canPop.wait(lock, [&] { return m_closed || slot.has_value(); });
+        if (!slot.has_value()) {
+            return false;
+        }
+        item = std::move(*slot);
+        slot.reset();
+        m_next++;
+        m_canPush.notify_all();
+        return true;
+    }
+
+    /**
+     * Closes the buffer and wakes all waiters
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_canPush.notify_all();
+        m_canPop.notify_all();
+    }
+
+private:
+    std::vector<std::optional<T>> m_slots;
+    size_t m_next = 0;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_canPush;
+    std::condition_variable m_canPop;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "fft.h"
+#include "fir_kernel.h"
+
+/**
+ * Interface for streaming FIR convolution
+ *
+ * Every call produces exactly as many output samples as it consumes; the
+ * engine carries whatever history it needs between calls.
+ */
+class ConvolutionEngine {
+public:
+    /**
+     * Destructor
+     */
+    virtual ~ConvolutionEngine() {}
+
+    /**
+     * Filters the next block of a stream
+     * @param input Input block
+     * @param output Output block, same length as input
+     * @param count Number of samples in the block
+     */
+    virtual void process(const float* input, float* output, size_t count) = 0;
+
+    /**
+     * Clears the stream history
+     */
+    virtual void reset() = 0;
+};
+
+/**
+ * Time-domain convolution, cheapest for short filters
+ *
+ * Runs the SIMD kernel from fir_kernel.h over a buffer that keeps the last
+ * numTaps - 1 input samples in front of each block.
+ */
+class DirectConvolution : public ConvolutionEngine {
+public:
+    /**
+     * Constructor
+     * @param taps Filter coefficients
+     */
+    explicit DirectConvolution(const std::vector<float>& taps);
+
+    void process(const float* input, float* output, size_t count) override;
+    void reset() override;
+
+private:
+    AlignedFloatVector m_reversedTaps;
+    AlignedFloatVector m_workBuffer;
+};
+
+/**
+ * Uniformly partitioned overlap-save convolution
+ *
+ * The filter is split into partitions of partitionSize taps, each applied in
+ * the frequency domain with a 2 * partitionSize FFT. Cost per sample grows
+ * with log(partitionSize) plus the partition count rather than with the tap
+ * count, which makes long filters cheap.
+ */
+class OverlapSaveConvolution : public ConvolutionEngine {
+public:
+    /**
+     * Constructor
+     * @param taps Filter coefficients
+     * @param partitionSize Block and partition length, power of 2 (0 = choose from tap count)
+     */
+    explicit OverlapSaveConvolution(const std::vector<float>& taps, int partitionSize = 0);
+
+    void process(const float* input, float* output, size_t count) override;
+    void reset() override;
+
+    /**
+     * Gets the partition length
+     * @return Samples per block
+     */
+    int partitionSize() const;
+
+private:
+    int m_partitionSize;
+    int m_numPartitions;
+    FftPlan m_plan;
+
+    std::vector<std::vector<std::complex<float>>> m_filterSpectra;
+    std::vector<std::vector<std::complex<float>>> m_inputSpectra;
+    int m_newestSpectrum = 0;
+
+    std::vector<float> m_inputWindow;
+    int m_blockFill = 0;
+    int m_blockEmitted = 0;
+
+    std::vector<std::complex<float>> m_partialSpectrum;
+    std::vector<std::complex<float>> m_accumulator;
+    std::vector<float> m_outputWindow;
+
+    void computeBlock(bool blockComplete);
+};
+
+/**
+ * Minimum tap count at which the FFT engine beats direct convolution
+ */
+constexpr size_t kFftConvolutionMinTaps = 1024;
+
+/**
+ * Factory function to create the faster engine for a filter
+ * @param taps Filter coefficients
+ * @return Convolution engine instance
+ */
+std::unique_ptr<ConvolutionEngine> createConvolutionEngine(const std::vector<float>& taps);
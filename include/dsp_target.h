@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * Marks a DSP kernel for function multiversioning
+ *
+ * With VIDEO_CLEANER_MULTIVERSION defined (the CMake option of the same name),
+ * GCC and Clang on x86 emit an AVX2 clone next to the baseline build and pick
+ * one at load time through an ifunc resolver, so a portable binary still runs
+ * the wide loops on machines that have them. The clone does not enable FMA:
+ * contraction would change rounding, and results would differ between CPUs.
+ *
+ * Kernels with hand-written intrinsics (firFilter) dispatch on their own and
+ * do not need this.
+ */
+#if defined(VIDEO_CLEANER_MULTIVERSION) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__) && defined(__ELF__)
+#define DSP_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define DSP_TARGET_CLONES
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <opencv2/opencv.hpp>
@@ -26,15 +27,24 @@ public:
     
     /**
      * Extracts faces from a video within a time range
+     *
+     * The video is opened once and decoded forward: frames between two
+     * timestamps are skipped with grab() and only the sampled frames are
+     * converted. Gaps longer than a typical GOP are skipped by seeking.
+     *
+     * With more than one job, detection runs on that many worker threads
+     * while this thread decodes, and the crops are written by a separate
+     * writer thread in timestamp order; file names do not depend on jobs.
      * @param videoPath Path to the video file
      * @param startTime Start time in seconds
      * @param endTime End time in seconds
      * @param interval Time interval in seconds between extractions
      * @param outputDir Directory where extracted faces will be saved
+     * @param jobs Number of face detection workers
      * @return True if extraction was successful, false otherwise
      */
     bool extractFacesFromRange(const std::string& videoPath, float startTime, float endTime, 
-                               float interval, const std::string& outputDir);
+                               float interval, const std::string& outputDir, int jobs = 1);
 
     /**
      * Checks if initialized
@@ -43,13 +53,79 @@ public:
     bool isInitialized() const;
 
 private:
+    /**
+     * Receives a sampled frame and its timestamp; the frame is empty if it could
+     * not be read. Returns false to stop decoding
+     */
+    using SampledFrameHandler = std::function<bool(float, const cv::Mat&)>;
+
+    /**
+     * Receives a sampled frame, its timestamp and the faces found in it, in timestamp order
+     */
+    using DetectionHandler = std::function<void(float, const cv::Mat&, const std::vector<cv::Rect>&)>;
+
+    /**
+     * Decoder counters, logged once the range is done
+     */
+    struct DecodeStats {
+        int framesGrabbed = 0;
+        int seeks = 0;
+    };
+
+    /**
+     * Decodes the frames at the given timestamps, walking the video forward
+     * @param video Opened video, positioned at the start
+     * @param timestamps Timestamps in seconds, ascending
+     * @param fps Frame rate of the video
+     * @param totalFrames Frame count of the video
+     * @param onFrame Called for every timestamp, with an empty frame if it could not be read
+     * @param stats Receives the decoder counters
+     * @return False if the handler stopped decoding
+     */
+    bool decodeSampledFrames(cv::VideoCapture& video, const std::vector<float>& timestamps, double fps,
+                             double totalFrames, const SampledFrameHandler& onFrame, DecodeStats& stats);
+
+    /**
+     * Decodes on the calling thread, detects on worker threads and reports results on a writer thread
+     * @param video Opened video, positioned at the start
+     * @param timestamps Timestamps in seconds, ascending
+     * @param fps Frame rate of the video
+     * @param totalFrames Frame count of the video
+     * @param jobs Number of detection workers
+     * @param onDetected Called on the writer thread for every timestamp, in timestamp order
+     * @param stats Receives the decoder counters
+     * @return False if the pipeline failed
+     */
+    bool detectInParallel(cv::VideoCapture& video, const std::vector<float>& timestamps, double fps,
+                          double totalFrames, int jobs, const DetectionHandler& onDetected, DecodeStats& stats);
+
+    /**
+     * Creates the output directory if it does not exist
+     * @param outputDir Directory path
+     * @return True if the directory exists afterwards
+     */
+    bool createOutputDir(const std::string& outputDir) const;
+
+    /**
+     * Writes each detected face as a JPEG crop
+     * @param frame Input video frame
+     * @param faces Detected faces
+     * @param timeInSeconds Timestamp of the frame, used in the file names
+     * @param videoPath Path of the source video, for log messages
+     * @param outputDir Directory where extracted faces will be saved
+     */
+    void writeFaces(const cv::Mat& frame, const std::vector<cv::Rect>& faces, float timeInSeconds,
+                    const std::string& videoPath, const std::string& outputDir) const;
+
     /**
      * Detects faces in a frame
      * @param frame Input video frame
+     * @param classifier Classifier to run; instances must not be shared between threads
      * @return Vector of detected faces
      */
-    std::vector<cv::Rect> detectFaces(const cv::Mat& frame);
+    std::vector<cv::Rect> detectFaces(const cv::Mat& frame, cv::CascadeClassifier& classifier) const;
 
     bool m_initialized = false;
+    std::string m_cascadePath;
     cv::CascadeClassifier m_faceClassifier;
 };
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+/**
+ * Radix-2 FFT with precomputed bit-reversal and twiddle tables
+ *
+ * A plan is built once per transform size and can be shared read-only
+ * between threads. Real-input transforms need a size of at least 2.
+ */
+class FftPlan {
+public:
+    /**
+     * Constructor
+     * @param size Transform size, must be a positive power of 2
+     */
+    explicit FftPlan(int size);
+
+    /**
+     * Gets the transform size
+     * @return Number of complex points
+     */
+    int size() const;
+
+    /**
+     * In-place forward transform
+     * @param data Buffer of size() points
+     */
+    void forward(std::complex<float>* data) const;
+
+    /**
+     * In-place inverse transform, scaled by 1/size()
+     * @param data Buffer of size() points
+     */
+    void inverse(std::complex<float>* data) const;
+
+    /**
+     * Forward transform of real input, computed with a half-size complex FFT
+     * @param input size() real samples
+     * @param output Receives the size() / 2 + 1 non-negative frequency bins
+     */
+    void forwardReal(const float* input, std::complex<float>* output) const;
+
+    /**
+     * Inverse of forwardReal, scaled by 1/size()
+     * @param input size() / 2 + 1 frequency bins
+     * @param output Receives size() real samples
+     */
+    void inverseReal(const std::complex<float>* input, float* output) const;
+
+private:
+    int m_size;
+    std::vector<int> m_bitReverse;
+    std::vector<int> m_halfBitReverse;
+    std::vector<std::complex<float>> m_twiddles;
+
+    void transform(std::complex<float>* data, int n, const std::vector<int>& bitReverse, bool inverse) const;
+};
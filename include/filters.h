@@ -4,6 +4,12 @@
 #include <complex>
 #include <memory>
 
+#include "convolution.h"
+#include "fft.h"
+#include "pipeline_stats.h"
+
+class ThreadPool;
+
 /**
  * Audio band-pass filter
  */
@@ -14,8 +20,9 @@ public:
      * @param sampleRate Audio sample rate in Hz
      * @param lowCutoff Lower cutoff frequency in Hz
      * @param highCutoff Higher cutoff frequency in Hz
+     * @param filterOrder FIR order; the filter has filterOrder + 1 taps
      */
-    BandPassFilter(int sampleRate, float lowCutoff, float highCutoff);
+    BandPassFilter(int sampleRate, float lowCutoff, float highCutoff, int filterOrder = 64);
 
     /**
      * Applies the filter
@@ -24,11 +31,26 @@ public:
      */
     std::vector<float> apply(const std::vector<float>& input);
 
+    /**
+     * Filters the next block of a stream, carrying FIR history between calls
+     * @param input Input block
+     * @param output Output block, same length as input
+     * @param count Number of samples in the block
+     */
+    void process(const float* input, float* output, size_t count);
+
+    /**
+     * Clears the stream history
+     */
+    void reset();
+
 private:
     int m_sampleRate;
     float m_lowCutoff;
     float m_highCutoff;
+    int m_filterOrder;
     std::vector<float> m_coefficients;
+    std::unique_ptr<ConvolutionEngine> m_engine;
     
     void calculateCoefficients();
 };
@@ -43,8 +65,14 @@ public:
      * @param fftSize FFT size to use for processing
      * @param hopSize Hop size between consecutive frames
      * @param reductionFactor Noise reduction factor (0-1)
+     * @param numThreads Threads sharing the frame loop; >1 splits long runs into time slices
      */
-    SpectralSubtraction(int sampleRate, int fftSize, int hopSize, float reductionFactor);
+    SpectralSubtraction(int sampleRate, int fftSize, int hopSize, float reductionFactor, int numThreads = 1);
+
+    /**
+     * Destructor
+     */
+    ~SpectralSubtraction();
 
     /**
      * Processes audio to remove noise
@@ -62,16 +90,60 @@ public:
      */
     std::vector<float> estimateNoiseProfile(const std::vector<float>& input, float durationSec = 0.5);
 
+    /**
+     * Processes the next block of a stream
+     *
+     * The noise profile is estimated from the start of the stream, so nothing
+     * is emitted until that much input has been pushed.
+     * @param input Input block
+     * @param count Number of samples in the block
+     * @param output Finished samples are appended here
+     */
+    void pushBlock(const float* input, size_t count, std::vector<float>& output);
+
+    /**
+     * Finishes the stream and emits all remaining samples
+     * @param output Remaining samples are appended here
+     */
+    void flush(std::vector<float>& output);
+
+    /**
+     * Discards stream state
+     */
+    void reset();
+
 private:
     int m_sampleRate;
     int m_fftSize;
     int m_hopSize;
     float m_reductionFactor;
+    FftPlan m_fftPlan;
+    std::vector<float> m_window;
+
+    /**
+     * Scratch buffers for one STFT frame, sized once so the frame loop never allocates
+     */
+    struct FrameWorkspace {
+        std::vector<float> samples;
+        std::vector<std::complex<float>> spectrum;
+    };
+    FrameWorkspace m_workspace;
+
+    std::unique_ptr<ThreadPool> m_pool;
+    std::vector<FrameWorkspace> m_sliceWorkspaces;
+
+    std::vector<float> m_pending;
+    std::vector<float> m_overlap;
+    std::vector<float> m_streamNoise;
+    bool m_hasStreamNoise = false;
     
-    void fft_complex_inplace(std::vector<std::complex<float>>& buffer);
-    std::vector<std::complex<float>> performFFT(const std::vector<float>& input, int start, int size);
-    std::vector<float> performIFFT(const std::vector<std::complex<float>>& spectrum);
-    std::vector<float> getWindowFunction(int size);
+    void performFFT(const float* input, FrameWorkspace& workspace) const;
+    void performIFFT(FrameWorkspace& workspace) const;
+    void processFrame(const float* input, const std::vector<float>& noise, FrameWorkspace& workspace,
+                      float* output, size_t begin, size_t end) const;
+    void overlapAddFrames(const float* input, size_t numFrames, const std::vector<float>& noise, float* output);
+    void processPendingFrames(std::vector<float>& output, bool finalBlock);
+    static std::vector<float> getWindowFunction(int size);
 };
 
 /**
@@ -85,8 +157,9 @@ public:
      * @param lowCutoff Lower cutoff frequency in Hz
      * @param highCutoff Higher cutoff frequency in Hz
      * @param noiseReduction Noise reduction factor (0-1)
+     * @param numThreads Threads for time-sliced spectral subtraction (1 = sequential)
      */
-    AudioProcessor(int sampleRate, float lowCutoff, float highCutoff, float noiseReduction);
+    AudioProcessor(int sampleRate, float lowCutoff, float highCutoff, float noiseReduction, int numThreads = 1);
 
     /**
      * Processes audio data
@@ -95,8 +168,33 @@ public:
      */
     std::vector<float> process(const std::vector<float>& input);
 
+    /**
+     * Processes the next block of a stream
+     *
+     * Memory use depends on the block size only, not on the stream length.
+     * @param input Input block
+     * @param count Number of samples in the block
+     * @param output Finished samples are appended here
+     */
+    void pushBlock(const float* input, size_t count, std::vector<float>& output);
+
+    /**
+     * Finishes the stream; total output length equals total input length
+     * @param output Remaining samples are appended here
+     */
+    void flush(std::vector<float>& output);
+
+    /**
+     * Adds the band-pass and spectral subtraction times of the streaming calls to a report
+     * @param stats Report to add to
+     */
+    void collectStageTimes(PipelineStats& stats) const;
+
 private:
     std::unique_ptr<BandPassFilter> m_bandPassFilter;
     std::unique_ptr<SpectralSubtraction> m_spectralSubtraction;
+    std::vector<float> m_filteredBlock;
     int m_sampleRate;
+    StageTime m_bandPassTime;
+    StageTime m_spectralSubtractionTime;
 };
\ No newline at end of file
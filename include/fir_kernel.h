@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Allocator returning storage aligned for SIMD loads
+ */
+template <typename T, size_t Alignment = 32>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+using AlignedFloatVector = std::vector<float, AlignedAllocator<float>>;
+
+/**
+ * FIR kernel over a history-prefixed buffer
+ *
+ * Computes output[i] = sum_k reversedTaps[k] * samples[i + k] for i < count,
+ * so samples must hold numTaps - 1 history values followed by the block.
+ * There are no bounds checks in the loop; the caller provides the history.
+ * @param samples History followed by input block
+ * @param reversedTaps Filter coefficients in reverse order
+ * @param numTaps Number of coefficients
+ * @param output Output block
+ * @param count Number of outputs
+ */
+void firFilter(const float* samples, const float* reversedTaps, size_t numTaps, float* output, size_t count);
+
+/**
+ * Portable reference version of firFilter
+ */
+void firFilterScalar(const float* samples, const float* reversedTaps, size_t numTaps, float* output, size_t count);
+
+/**
+ * Gets the kernel variant selected for this CPU
+ * @return "avx2", "sse" or "scalar"
+ */
+const char* firKernelName();
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Recycles frame buffers between pipeline stages
+ *
+ * Stages take buffers with acquire() and the last stage hands them back with
+ * recycle(). Buffers are matched by size and type, so a stream of same-sized
+ * frames keeps reusing a fixed set of allocations. Safe to use from several
+ * threads.
+ */
+class FramePool {
+public:
+    /**
+     * Constructor
+     * @param capacity Maximum number of idle buffers kept for reuse
+     */
+    explicit FramePool(size_t capacity);
+
+    /**
+     * Gets a buffer, reusing an idle one of the same size and type if possible
+     * @param rows Frame height
+     * @param cols Frame width
+     * @param type OpenCV element type
+     * @return Buffer with unspecified contents
+     */
+    cv::Mat acquire(int rows, int cols, int type);
+
+    /**
+     * Returns a buffer to the pool and empties the caller's header
+     *
+     * Buffers still referenced elsewhere, views into larger matrices, and
+     * buffers beyond the capacity are released instead.
+     * @param frame Buffer to return
+     */
+    void recycle(cv::Mat& frame);
+
+    /**
+     * Gets the number of buffers the pool has had to allocate
+     * @return Allocation count
+     */
+    size_t allocations() const;
+
+private:
+    size_t m_capacity;
+    std::vector<cv::Mat> m_idle;
+    size_t m_allocations = 0;
+    mutable std::mutex m_mutex;
+};
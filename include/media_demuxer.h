@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "pipeline_stats.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwrContext;
+struct SwsContext;
+class FramePool;
+
+/**
+ * Frees an AVPacket owned by a PacketPtr
+ */
+struct AVPacketDeleter {
+    void operator()(AVPacket* packet) const;
+};
+
+using PacketPtr = std::unique_ptr<AVPacket, AVPacketDeleter>;
+
+/**
+ * Layout of decoded video frames
+ */
+enum class FrameFormat {
+    Bgr,      // Packed BGR, CV_8UC3
+    Yuv420    // Planar I420: CV_8UC1 with height * 3 / 2 rows, Y then U then V
+};
+
+/**
+ * Reads an input file once and feeds both the video and the audio branch
+ *
+ * run() demuxes every packet a single time. Video packets are decoded on the
+ * calling thread into BGR or I420 frames; audio packets are handed on undecoded so the
+ * audio branch can decode them on its own thread with decodeAudio().
+ */
+class MediaDemuxer {
+public:
+    using VideoFrameHandler = std::function<bool(cv::Mat& frame)>;
+    using AudioPacketHandler = std::function<bool(PacketPtr packet)>;
+    using AudioBlockHandler = std::function<bool(const float* const* channelData, int numSamples)>;
+
+    /**
+     * Constructor
+     */
+    MediaDemuxer();
+
+    /**
+     * Destructor
+     */
+    ~MediaDemuxer();
+
+    MediaDemuxer(const MediaDemuxer&) = delete;
+    MediaDemuxer& operator=(const MediaDemuxer&) = delete;
+
+    /**
+     * Opens the input and its video and audio decoders
+     * @param inputPath Input video path
+     * @return True if a video stream could be opened
+     */
+    bool open(const std::string& inputPath);
+
+    /**
+     * Gets the decoded frame width
+     * @return Width in pixels
+     */
+    int width() const { return m_width; }
+
+    /**
+     * Gets the decoded frame height
+     * @return Height in pixels
+     */
+    int height() const { return m_height; }
+
+    /**
+     * Gets the video frame rate
+     * @return Frames per second
+     */
+    double fps() const { return m_fps; }
+
+    /**
+     * Gets the frame count from the container, or an estimate from the duration
+     * @return Frame count, 0 if unknown
+     */
+    int totalFrames() const { return m_totalFrames; }
+
+    /**
+     * Gets the video rotation as a display matrix
+     * @return Nine-element display matrix, or nullptr if the stream has none
+     */
+    const int32_t* displayMatrix() const { return m_hasDisplayMatrix ? m_displayMatrix.data() : nullptr; }
+
+    /**
+     * Checks whether an audio stream was opened
+     * @return True if the input has decodable audio
+     */
+    bool hasAudio() const { return m_audioCodec != nullptr; }
+
+    /**
+     * Gets the audio sample rate
+     * @return Sample rate in Hz
+     */
+    int sampleRate() const { return m_sampleRate; }
+
+    /**
+     * Gets the audio channel count
+     * @return Number of channels
+     */
+    int channels() const { return m_channels; }
+
+    /**
+     * Selects the layout of decoded frames; I420 needs an even frame size
+     * @param format Frame layout, BGR by default
+     */
+    void setFrameFormat(FrameFormat format) { m_frameFormat = format; }
+
+    /**
+     * Takes decoded frame buffers from a pool instead of allocating each one
+     * @param pool Pool shared with the stages that recycle the frames, or nullptr
+     */
+    void setFramePool(FramePool* pool) { m_framePool = pool; }
+
+    /**
+     * Reads the whole input once
+     *
+     * Stops early when a handler returns false.
+     * @param onVideoFrame Receives each decoded frame in display order
+     * @param onAudioPacket Receives each audio packet, undecoded
+     * @return True if the input was read to the end
+     */
+    bool run(const VideoFrameHandler& onVideoFrame, const AudioPacketHandler& onAudioPacket);
+
+    /**
+     * Decodes an audio packet into planar float blocks; safe to call from another thread than run()
+     * @param packet Packet from run(), or nullptr to drain the decoder at the end of the stream
+     * @param onBlock Receives each converted block
+     * @return False if onBlock returned false
+     */
+    bool decodeAudio(const AVPacket* packet, const AudioBlockHandler& onBlock);
+
+    /**
+     * Adds the decode and resample times to a report; call once reading and audio decoding are done
+     * @param stats Report to add to
+     */
+    void collectStageTimes(PipelineStats& stats) const;
+
+private:
+    AVFormatContext* m_formatContext = nullptr;
+
+    int m_videoStreamIndex = -1;
+    AVCodecContext* m_videoCodec = nullptr;
+    AVFrame* m_videoFrame = nullptr;
+    SwsContext* m_swsContext = nullptr;
+    FramePool* m_framePool = nullptr;
+    FrameFormat m_frameFormat = FrameFormat::Bgr;
+    int m_width = 0;
+    int m_height = 0;
+    double m_fps = 0.0;
+    int m_totalFrames = 0;
+    std::array<int32_t, 9> m_displayMatrix = {};
+    bool m_hasDisplayMatrix = false;
+    StageTime m_videoDecodeTime;  // Updated by the thread calling run()
+
+    int m_audioStreamIndex = -1;
+    AVCodecContext* m_audioCodec = nullptr;
+    AVFrame* m_audioFrame = nullptr;
+    SwrContext* m_swrContext = nullptr;
+    std::vector<uint8_t*> m_audioBuffer;
+    int m_audioBufferSamples = 0;
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    StageTime m_audioDecodeTime;  // Updated by the thread calling decodeAudio()
+    StageTime m_resampleTime;
+
+    bool openVideoDecoder();
+    bool openAudioDecoder();
+    bool decodeVideo(const AVPacket* packet, const VideoFrameHandler& onVideoFrame);
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include "pipeline_stats.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+struct AVPacket;
+struct AVAudioFifo;
+struct SwsContext;
+
+/**
+ * Video encoder parameters; fields left at their defaults keep the encoder's own choice
+ */
+struct EncoderSettings {
+    std::string codec = "libx264";  // Encoder name (libx264, libx265, libsvtav1, ...) or codec name (h264, hevc, ...)
+    std::string preset;             // Encoder speed preset, empty = encoder default
+    int crf = -1;                   // Constant rate factor, < 0 = encoder default
+    int64_t bitrate = 0;            // Target bitrate in bits/s, 0 = rate control by CRF
+    int threads = -1;               // Encoder threads, 0 = one per core, < 0 = FFmpeg default (1)
+    int gopSize = 0;                // Maximum frames between keyframes, 0 = encoder default
+};
+
+/**
+ * Encodes processed video and audio straight into the final container
+ *
+ * Video frames and audio blocks may be written from different threads; each
+ * stream has its own encoder and only the container write is serialized.
+ */
+class MediaMuxer {
+public:
+    /**
+     * Constructor
+     */
+    MediaMuxer();
+
+    /**
+     * Destructor, releases the output without finalizing it
+     */
+    ~MediaMuxer();
+
+    MediaMuxer(const MediaMuxer&) = delete;
+    MediaMuxer& operator=(const MediaMuxer&) = delete;
+
+    /**
+     * Creates the output container, choosing the format from the file extension
+     * @param outputPath Output file path
+     * @return True if successful
+     */
+    bool open(const std::string& outputPath);
+
+    /**
+     * Adds a video stream fed with BGR or I420 frames
+     * @param width Frame width
+     * @param height Frame height
+     * @param fps Frame rate
+     * @param settings Encoder selection and rate control
+     * @param displayMatrix Optional nine-element rotation matrix stored with the stream
+     * @return True if successful
+     */
+    bool addVideoStream(int width, int height, double fps, const EncoderSettings& settings = EncoderSettings(),
+                        const int32_t* displayMatrix = nullptr);
+
+    /**
+     * Adds an AAC audio stream fed with planar float samples
+     * @param sampleRate Sample rate in Hz
+     * @param channels Number of channels
+     * @return True if successful
+     */
+    bool addAudioStream(int sampleRate, int channels);
+
+    /**
+     * Opens the output file and writes the container header; call after adding all streams
+     *
+     * With both streams present the output stops at the end of the shorter
+     * one, like ffmpeg -shortest.
+     * @return True if successful
+     */
+    bool writeHeader();
+
+    /**
+     * Encodes the next video frame
+     * @param frame BGR frame matching the stream size, or an I420 frame (CV_8UC1, height * 3 / 2 rows)
+     * @return True if successful
+     */
+    bool writeVideoFrame(const cv::Mat& frame);
+
+    /**
+     * Encodes the next block of audio
+     * @param channelData One pointer per channel
+     * @param numSamples Samples per channel
+     * @return True if successful
+     */
+    bool writeAudio(const float* const* channelData, int numSamples);
+
+    /**
+     * Drains both encoders and writes the container trailer
+     * @return True if successful
+     */
+    bool finish();
+
+    /**
+     * Adds the encode and mux times to a report; call once both streams are done
+     * @param stats Report to add to
+     */
+    void collectStageTimes(PipelineStats& stats) const;
+
+private:
+    std::string m_outputPath;
+    AVFormatContext* m_formatContext = nullptr;
+    bool m_headerWritten = false;
+    std::mutex m_writeMutex;
+
+    AVStream* m_videoStream = nullptr;
+    AVCodecContext* m_videoCodec = nullptr;
+    AVFrame* m_videoFrame = nullptr;
+    AVPacket* m_videoPacket = nullptr;
+    SwsContext* m_swsContext = nullptr;
+    int64_t m_videoFramesWritten = 0;
+
+    AVStream* m_audioStream = nullptr;
+    AVCodecContext* m_audioCodec = nullptr;
+    AVFrame* m_audioFrame = nullptr;
+    AVPacket* m_audioPacket = nullptr;
+    AVAudioFifo* m_audioFifo = nullptr;
+    int m_audioFrameSize = 0;
+    int64_t m_audioSamplesWritten = 0;
+
+    StageTime m_videoEncodeTime;  // Updated by the video thread
+    StageTime m_audioEncodeTime;  // Updated by the audio thread
+    StageTime m_muxTime;          // Updated under m_writeMutex
+
+    bool encodeAudioFrame(int numSamples);
+    bool encode(AVCodecContext* codecContext, AVStream* stream, AVFrame* frame, AVPacket* packet,
+                StageTime& encodeTime);
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Processing stages timed by the pipeline
+ */
+enum class PipelineStage {
+    AudioDecode,
+    Resample,
+    BandPass,
+    SpectralSubtraction,
+    AudioEncode,
+    VideoDecode,
+    Denoise,
+    VideoEncode,
+    Mux,
+    Count
+};
+
+/**
+ * Time spent in one stage and the work it got done
+ *
+ * Wall time is summed over every call, so a stage run by several threads at
+ * once can report more wall time than the whole run took.
+ */
+struct StageTime {
+    double wallSeconds = 0.0;       // Time inside the stage
+    double callerCpuSeconds = 0.0;  // CPU time of the calling thread only; helper threads are not counted
+    uint64_t items = 0;             // Frames, samples or packets processed
+
+    /**
+     * Adds another set of times
+     * @param other Times to add
+     * @return This object
+     */
+    StageTime& operator+=(const StageTime& other) {
+        wallSeconds += other.wallSeconds;
+        callerCpuSeconds += other.callerCpuSeconds;
+        items += other.items;
+        return *this;
+    }
+};
+
+/**
+ * Gets the CPU time used by the calling thread
+ * @return CPU seconds
+ */
+inline double threadCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Gets the CPU time used by all threads of the process
+ * @return CPU seconds
+ */
+inline double processCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Gets a monotonic wall clock reading
+ * @return Seconds since an arbitrary fixed point
+ */
+inline double monotonicSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<double>(now.tv_sec) + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Adds the time between construction and destruction to a StageTime
+ *
+ * The target must only be updated from one thread at a time; components keep
+ * one StageTime per stage and thread and merge them when the run ends.
+ */
+class StageTimer {
+public:
+    /**
+     * Starts timing
+     * @param target Receives the time, or nullptr to time nothing
+     * @param items Work done by this call
+     */
+    explicit StageTimer(StageTime* target, uint64_t items = 0)
+        : m_target(target), m_items(items) {
+        if (m_target) {
+            m_wallStart = monotonicSeconds();
+            m_cpuStart = threadCpuSeconds();
+        }
+    }
+
+    /**
+     * Stops timing unless stop() already did
+     */
+    ~StageTimer() { stop(); }
+
+    /**
+     * Stops timing early and adds the result to the target
+     */
+    void stop() {
+        if (m_target) {
+            m_target->wallSeconds += monotonicSeconds() - m_wallStart;
+            m_target->callerCpuSeconds += threadCpuSeconds() - m_cpuStart;
+            m_target->items += m_items;
+            m_target = nullptr;
+        }
+    }
+
+    /**
+     * Sets the work done when it is only known at the end of the call
+     * @param items Work done by this call
+     */
+    void setItems(uint64_t items) { m_items = items; }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    StageTime* m_target;
+    uint64_t m_items;
+    double m_wallStart = 0.0;
+    double m_cpuStart = 0.0;
+};
+
+/**
+ * Per-stage times for one run, with a console summary and a JSON report
+ */
+class PipelineStats {
+public:
+    /**
+     * Adds time to a stage
+     * @param stage Stage
+     * @param time Time and work to add
+     */
+    void add(PipelineStage stage, const StageTime& time);
+
+    /**
+     * Gets the totals of a stage
+     * @param stage Stage
+     * @return Totals
+     */
+    const StageTime& stage(PipelineStage stage) const { return m_stages[static_cast<size_t>(stage)]; }
+
+    /**
+     * Records the elapsed time and process CPU time of the whole run
+     * @param wallSeconds Elapsed seconds
+     * @param cpuSeconds CPU seconds over all threads
+     */
+    void setTotals(double wallSeconds, double cpuSeconds);
+
+    /**
+     * Adds a descriptive entry (input path, settings) to the report
+     * @param key Entry name
+     * @param value Entry value
+     */
+    void setInfo(const std::string& key, const std::string& value);
+
+    /**
+     * Prints one line per stage that ran
+     * @param out Output stream
+     */
+    void print(std::ostream& out) const;
+
+    /**
+     * Writes the report as JSON
+     * @param path Output file path
+     * @return True if successful
+     */
+    bool writeJson(const std::string& path) const;
+
+    /**
+     * Gets the report name of a stage
+     * @param stage Stage
+     * @return Name in snake_case
+     */
+    static const char* stageName(PipelineStage stage);
+
+    /**
+     * Gets the unit a stage counts its work in
+     * @param stage Stage
+     * @return Unit name
+     */
+    static const char* stageUnit(PipelineStage stage);
+
+private:
+    std::array<StageTime, static_cast<size_t>(PipelineStage::Count)> m_stages = {};
+    std::vector<std::pair<std::string, std::string>> m_info;
+    double m_wallSeconds = 0.0;
+    double m_cpuSeconds = 0.0;
+};
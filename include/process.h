@@ -2,12 +2,20 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <functional>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
 
+#include "bounded_queue.h"
 #include "filters.h"
+#include "media_demuxer.h"
+#include "media_muxer.h"
+#include "video_denoise.h"
 
-// Forward declaration
-class VideoDenoiser;
+// Forward declarations
+class ThreadPool;
+class FramePool;
 
 /**
  * Handles the video processing pipeline
@@ -20,8 +28,18 @@ public:
      * @param highCutoff Higher cutoff frequency in Hz for audio filter
      * @param noiseReduction Audio noise reduction factor (0-1)
      * @param videoDenoiseStrength Video denoising strength (0-100)
+     * @param numThreads Number of parallel video denoise workers (1 = single-threaded)
+     * @param denoiserOptions Video denoiser backend and its parameters
+     * @param encoderSettings Video encoder selection and rate control
      */
-    VideoProcessor(float lowCutoff, float highCutoff, float noiseReduction, float videoDenoiseStrength);
+    VideoProcessor(float lowCutoff, float highCutoff, float noiseReduction, float videoDenoiseStrength,
+                   int numThreads = 1, const VideoDenoiserOptions& denoiserOptions = VideoDenoiserOptions(),
+                   const EncoderSettings& encoderSettings = EncoderSettings());
+
+    /**
+     * Destructor
+     */
+    ~VideoProcessor();
     
     /**
      * Processes a video file
@@ -31,25 +49,75 @@ public:
      */
     bool processVideo(const std::string& inputPath, const std::string& outputPath);
 
+    /**
+     * Writes a JSON report of per-stage times after each successful run
+     * @param path Report path, or empty for the console summary only
+     */
+    void setStatsPath(const std::string& path) { m_statsPath = path; }
+
+    /**
+     * Records each frame's decode-to-encode latency in the following runs
+     * @param record True to record; off by default so long runs keep no per-frame data
+     */
+    void setRecordLatencies(bool record) { m_recordLatencies = record; }
+
+    /**
+     * Gets the time each frame of the last run spent between leaving the decoder and being encoded
+     * @return Latency in seconds per frame, in output order; empty unless recording was enabled
+     */
+    const std::vector<double>& frameLatencies() const { return m_frameLatencies; }
+
 private:
     float m_lowCutoff;
     float m_highCutoff;
     float m_noiseReduction;
     float m_videoDenoiseStrength;
+    int m_numThreads;
+    VideoDenoiserOptions m_denoiserOptions;
+    EncoderSettings m_encoderSettings;
+    std::string m_statsPath;
+    bool m_recordLatencies = false;
 
     int m_lastFrameWidth = 0;
     int m_lastFrameHeight = 0;
 
-    std::unique_ptr<AudioProcessor> m_audioProcessor;
+    std::vector<std::unique_ptr<AudioProcessor>> m_channelProcessors;
+    std::vector<std::vector<float>> m_channelOutput;
+    std::vector<const float*> m_channelOutputPointers;
+    std::unique_ptr<ThreadPool> m_audioPool;
     std::unique_ptr<VideoDenoiser> m_videoDenoiser;
+    bool m_videoDenoiserPlanar = false;  // Frame format m_videoDenoiser was built for
+    SkipStats m_skipStats;   // Change detection counters for the last video pass
+    StageTime m_denoiseTime; // Denoise time for the last video pass, summed over workers
+    std::vector<double> m_frameLatencies;
+
+    /**
+     * Decoded frame tagged with its position in the stream
+     */
+    struct DecodedFrame {
+        size_t index = 0;
+        cv::Mat image;
+        double decodedAt = 0.0;  // monotonicSeconds() when the frame left the decoder
+    };
+
+    using FrameQueue = BoundedQueue<DecodedFrame>;
+    using AudioPacketQueue = BoundedQueue<PacketPtr>;
 
-    bool extractAudio(const std::string& videoPath, std::vector<float>& audioData, int& sampleRate, int& channels);
-    bool processAudio(std::vector<float>& audioData, int sampleRate, int channels);
-    bool saveProcessedAudioToWav(const std::string& wavPath, const std::vector<float>& audioData,
-                               int audioSampleRate, int audioChannels);
-    bool processVideoFrames(const std::string& inputPath, const std::string& outputPath,
-                           const std::vector<float>& processedAudio, int audioSampleRate, int audioChannels);
+    bool beginAudioProcessing(int sampleRate, int channels);
+    void processAudio(const float* const* channelData, int numSamples);
+    void flushAudioProcessing();
+    void runChannelWorkers(const std::function<void(size_t channel, std::vector<float>& output)>& step);
+    bool writeProcessedAudio(MediaMuxer& muxer);
+    bool processAudioBranch(MediaDemuxer& demuxer, AudioPacketQueue& packets, MediaMuxer& muxer);
+    bool processVideoFrames(FrameQueue& frames, FramePool& framePool, MediaMuxer& muxer, int totalFrames,
+                            const VideoDenoiserOptions& denoiserOptions);
+    bool runSequentialFrameLoop(FrameQueue& frames, FramePool& framePool, MediaMuxer& muxer, int totalFrames);
+    bool runPipelinedFrameLoop(FrameQueue& frames, FramePool& framePool, MediaMuxer& muxer, int totalFrames,
+                               const VideoDenoiserOptions& denoiserOptions);
+    void reportFrameProgress(int frameCount, int totalFrames);
+    void reportSkipStats() const;
+    void reportStageTimes(const MediaDemuxer& demuxer, const MediaMuxer& muxer, const std::string& inputPath,
+                          double wallSeconds, double cpuSeconds);
 
-    cv::Mat denoiseFrame(const cv::Mat& frame);
-    void applyAdditionalVideoEnhancements(cv::Mat& frame);
+    void denoiseFrame(const cv::Mat& frame, cv::Mat& denoisedFrame);
 };
\ No newline at end of file
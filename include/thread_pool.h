@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads for fork-join loops
+ *
+ * The calling thread takes part in every loop, so a pool of size N keeps
+ * N - 1 background threads.
+ */
+class ThreadPool {
+public:
+    /**
+     * Constructor
+     * @param numThreads Total threads working on each loop, including the caller (at least 1)
+     */
+    explicit ThreadPool(int numThreads);
+
+    /**
+     * Destructor, stops and joins the workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Gets the number of threads working on each loop
+     * @return Thread count, including the caller
+     */
+    int size() const { return static_cast<int>(m_workers.size()) + 1; }
+
+    /**
+     * Runs task(i) for every i in [0, count) and waits for all of them
+     *
+     * The first exception thrown by a task is rethrown here once the loop has finished.
+     * @param count Number of iterations
+     * @param task Iteration body, called concurrently from several threads
+     */
+    template <typename Task>
+    void parallelFor(size_t count, const Task& task) {
+        // Type-erased through a plain function pointer so that dispatching a
+        // loop never allocates, unlike std::function with a large capture
+        run(count, [](const void* context, size_t index) { (*static_cast<const Task*>(context))(index); }, &task);
+    }
+
+private:
+    using TaskInvoker = void (*)(const void* context, size_t index);
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_loopMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_startLoop;
+    std::condition_variable m_loopDone;
+
+    TaskInvoker m_invoke = nullptr;
+    const void* m_context = nullptr;
+    size_t m_count = 0;
+    size_t m_nextIndex = 0;
+    size_t m_pending = 0;
+    size_t m_generation = 0;
+    bool m_stopping = false;
+    std::exception_ptr m_error;
+
+    void run(size_t count, TaskInvoker invoke, const void* context);
+    void workerLoop();
+    void runIterations(std::unique_lock<std::mutex>& lock);
+};
@@ -1,7 +1,57 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 #include <opencv2/opencv.hpp>
 
+/**
+ * Available video denoising algorithms
+ */
+enum class DenoiserBackend {
+    Spatial,   // Per-frame NLM / bilateral filtering
+    Temporal   // Motion-aware average over a window of recent frames
+};
+
+/**
+ * Options selecting and tuning the video denoiser
+ */
+struct VideoDenoiserOptions {
+    DenoiserBackend backend = DenoiserBackend::Spatial;
+    int temporalWindow = 5;   // Frames averaged by the temporal backend, including the current one
+    double contrast = 1.2;    // Gain applied to every output pixel
+    double brightness = 5.0;  // Offset added after the gain
+    int tileSize = 0;         // NLM tile edge in pixels for the spatial backend, 0 = whole frame
+    bool planarYuv = false;   // Frames are I420 (CV_8UC1, Y/U/V planes); each plane is denoised on its own
+    bool preview = false;     // Denoise a downscaled luma plane and upsample it guided by the input
+    int previewScale = 2;     // Downscale factor for preview mode
+    double skipThreshold = -1.0;  // Mean absolute difference at or below which a tile reuses the previous output, < 0 = off
+};
+
+/**
+ * Counters from change detection
+ */
+struct SkipStats {
+    uint64_t frames = 0;         // Frames checked
+    uint64_t skippedFrames = 0;  // Frames whose previous output was reused entirely
+    uint64_t tiles = 0;          // Tiles checked
+    uint64_t skippedTiles = 0;   // Tiles whose previous output was reused
+
+    /**
+     * Adds another set of counters
+     * @param other Counters to add
+     * @return This object
+     */
+    SkipStats& operator+=(const SkipStats& other) {
+        frames += other.frames;
+        skippedFrames += other.skippedFrames;
+        tiles += other.tiles;
+        skippedTiles += other.skippedTiles;
+        return *this;
+    }
+};
+
 /**
  * Interface for video denoising
  */
@@ -26,14 +76,59 @@ public:
     virtual void initialize(int width, int height) = 0;
 
     /**
-     * Denoises a frame
+     * Denoises a frame into a caller-owned buffer
+     *
+     * The buffer is reused when it already has the input's size and type, so
+     * callers that recycle output frames avoid a per-frame allocation.
+     * @param inputFrame Input frame
+     * @param outputFrame Receives the denoised frame; must not share data with inputFrame
+     */
+    virtual void denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) = 0;
+
+    /**
+     * Denoises a frame into a newly allocated buffer
      * @param inputFrame Input frame
      * @return Denoised frame
      */
-    virtual cv::Mat denoise(const cv::Mat& inputFrame) = 0;
+    cv::Mat denoise(const cv::Mat& inputFrame) {
+        cv::Mat outputFrame;
+        denoise(inputFrame, outputFrame);
+        return outputFrame;
+    }
+
+    /**
+     * Checks whether the output depends on earlier frames
+     *
+     * Such denoisers must see every frame of a stream, in order, on one instance.
+     * @return True for temporal denoisers and change detection
+     */
+    virtual bool isTemporal() const { return false; }
+
+    /**
+     * Sets the brightness/contrast stage applied to every output frame
+     *
+     * Backends fold it into their last write where they can, so it does not
+     * cost a separate pass over the frame. alpha 1 and beta 0 disable it.
+     * @param alpha Contrast gain
+     * @param beta Brightness offset
+     */
+    virtual void setEnhancement(double alpha, double beta);
+
+    /**
+     * Gets the change detection counters
+     * @return Counters, all zero when change detection is off
+     */
+    virtual SkipStats skipStats() const { return SkipStats(); }
 
 protected:
     float m_strength;
+    cv::Mat m_enhanceTable;   // 256-entry lookup of saturate(alpha * v + beta), empty when disabled
+
+    /**
+     * Applies the enhancement in place, for outputs written by code that cannot fuse it
+     * @param frame 8-bit frame to adjust
+     */
+    void applyEnhancement(cv::Mat& frame) const;
 };
 
 /**
@@ -44,8 +139,9 @@ public:
     /**
      * Constructor
      * @param strength Denoising strength
+     * @param tileSize Edge of the square tiles NLM runs on in parallel, 0 to filter whole frames
      */
-    CPUVideoDenoiser(float strength);
+    CPUVideoDenoiser(float strength, int tileSize = 0);
     
     /**
      * Destructor
@@ -59,22 +155,323 @@ public:
      */
     void initialize(int width, int height) override;
 
+    using VideoDenoiser::denoise;
+
     /**
      * Denoises a frame using CPU
      * @param inputFrame Input frame
-     * @return Denoised frame
+     * @param outputFrame Receives the denoised frame
      */
-    cv::Mat denoise(const cv::Mat& inputFrame) override;
+    void denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) override;
 
 private:
     int m_width = 0;
     int m_height = 0;
     bool m_initialized = false;
+    int m_tileSize;
+    cv::Mat m_intermediate;   // Bilateral output feeding NLM at the highest strengths
+
+    /**
+     * Runs NLM, optionally after a bilateral prefilter, on the whole frame or in tiles
+     * @param inputFrame Input frame
+     * @param outputFrame Receives the filtered, enhanced frame
+     * @param prefilter True to run the bilateral filter first
+     * @param h NLM filter strength for luma and colour
+     * @param searchWindow NLM search window size
+     */
+    void denoiseNlm(const cv::Mat& inputFrame, cv::Mat& outputFrame, bool prefilter, float h, int searchWindow);
+
+    /**
+     * Runs NLM on overlapping tiles in parallel and writes back each tile's core
+     *
+     * Tiles carry a halo of half the search plus half the template window, so
+     * every output pixel sees the same neighbourhood as in a whole-frame call.
+     * @param inputFrame Input frame
+     * @param outputFrame Receives the filtered, enhanced frame
+     * @param prefilter True to run the bilateral filter first
+     * @param h NLM filter strength for luma and colour
+     * @param searchWindow NLM search window size
+     */
+    void denoiseNlmTiles(const cv::Mat& inputFrame, cv::Mat& outputFrame, bool prefilter, float h,
+                         int searchWindow) const;
+
+    /**
+     * Runs the bilateral filter in row strips, enhancing each strip while it is still in cache
+     * @param inputFrame Input frame
+     * @param outputFrame Receives the filtered, enhanced frame
+     */
+    void bilateralEnhanced(const cv::Mat& inputFrame, cv::Mat& outputFrame) const;
+};
+
+/**
+ * Temporal video denoiser for static-camera content
+ *
+ * Each output subpixel is the mean of the co-located subpixels in the last
+ * N frames that lie within a strength-derived threshold of the current value.
+ * Static areas are averaged over the whole window while moving edges and
+ * scene cuts fall back to the current frame, so no motion search is needed.
+ */
+class TemporalVideoDenoiser : public VideoDenoiser {
+public:
+    /**
+     * Constructor
+     * @param strength Denoising strength
+     * @param windowSize Frames in the window, including the current one (2-16)
+     */
+    TemporalVideoDenoiser(float strength, int windowSize);
+
+    /**
+     * Destructor
+     */
+    ~TemporalVideoDenoiser() override;
+
+    /**
+     * Initializes the frame history, discarding earlier frames
+     * @param width Frame width
+     * @param height Frame height
+     */
+    void initialize(int width, int height) override;
+
+    using VideoDenoiser::denoise;
+
+    /**
+     * Denoises a frame against the recent frame history
+     * @param inputFrame Input frame
+     * @param outputFrame Receives the denoised frame
+     */
+    void denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) override;
+
+    /**
+     * Checks whether the output depends on earlier frames
+     * @return Always true
+     */
+    bool isTemporal() const override { return true; }
+
+private:
+    int m_windowSize;
+    int m_threshold;
+    int m_width = 0;
+    int m_height = 0;
+    std::vector<cv::Mat> m_history;
+    size_t m_nextSlot = 0;
+    size_t m_historyFrames = 0;
+    std::vector<int> m_reciprocals;
+};
+
+/**
+ * Fast preview denoiser working on a downscaled luma plane
+ *
+ * The frame is converted to YCrCb and shrunk by the preview scale. The wrapped
+ * denoiser cleans the small luma plane, and a guided filter with the
+ * full-resolution luma as guide brings it back to full size, so edges stay
+ * sharp. Chroma is only smoothed at the reduced size, as 4:2:0 video already
+ * stores it.
+ */
+class PreviewVideoDenoiser : public VideoDenoiser {
+public:
+    /**
+     * Constructor
+     * @param strength Denoising strength
+     * @param inner Denoiser run on the downscaled luma plane
+     * @param scale Downscale factor (2-4)
+     */
+    PreviewVideoDenoiser(float strength, std::unique_ptr<VideoDenoiser> inner, int scale);
+
+    /**
+     * Destructor
+     */
+    ~PreviewVideoDenoiser() override;
+
+    /**
+     * Initializes the wrapped denoiser for the downscaled size
+     * @param width Frame width
+     * @param height Frame height
+     */
+    void initialize(int width, int height) override;
+
+    using VideoDenoiser::denoise;
+
+    /**
+     * Denoises a frame at reduced resolution
+     * @param inputFrame Input BGR frame
+     * @param outputFrame Receives the denoised frame
+     */
+    void denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) override;
+
+    /**
+     * Checks whether the output depends on earlier frames
+     * @return True if the wrapped denoiser is temporal
+     */
+    bool isTemporal() const override { return m_inner->isTemporal(); }
+
+private:
+    std::unique_ptr<VideoDenoiser> m_inner;
+    int m_scale;
+    double m_epsilon;
+    cv::Size m_smallSize;
+
+    // Scratch planes, reused from frame to frame
+    cv::Mat m_ycrcb;
+    cv::Mat m_smallYcrcb;
+    cv::Mat m_smallLuma;
+    cv::Mat m_smallDenoised;
+    cv::Mat m_guide;
+    cv::Mat m_target;
+    cv::Mat m_meanGuide;
+    cv::Mat m_meanTarget;
+    cv::Mat m_product;
+    cv::Mat m_gain;
+    cv::Mat m_offset;
+    cv::Mat m_fullGain;
+    cv::Mat m_fullOffset;
+    cv::Mat m_chroma;
+
+    /**
+     * Upsamples the denoised small luma with a guided filter
+     *
+     * The full-resolution luma in m_ycrcb is the guide; the result replaces
+     * the luma channel of m_chroma.
+     */
+    void guidedUpsample();
+};
+
+/**
+ * Denoiser for planar I420 frames
+ *
+ * Runs one wrapped denoiser per plane: luma at full size and the two chroma
+ * planes at quarter size. Frames stay in the decoder's YUV layout from input
+ * to encoder, so no colour conversion is needed anywhere in the pipeline.
+ */
+class PlanarVideoDenoiser : public VideoDenoiser {
+public:
+    /**
+     * Constructor
+     * @param strength Denoising strength
+     * @param luma Denoiser for the Y plane
+     * @param blue Denoiser for the U (Cb) plane
+     * @param red Denoiser for the V (Cr) plane
+     */
+    PlanarVideoDenoiser(float strength, std::unique_ptr<VideoDenoiser> luma, std::unique_ptr<VideoDenoiser> blue,
+                        std::unique_ptr<VideoDenoiser> red);
+
+    /**
+     * Destructor
+     */
+    ~PlanarVideoDenoiser() override;
+
+    /**
+     * Initializes the plane denoisers
+     * @param width Frame width
+     * @param height Rows of the I420 buffer, 3/2 of the picture height
+     */
+    void initialize(int width, int height) override;
+
+    using VideoDenoiser::denoise;
+
+    /**
+     * Denoises the three planes of an I420 frame
+     * @param inputFrame Continuous I420 frame
+     * @param outputFrame Receives the denoised I420 frame
+     */
+    void denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) override;
+
+    /**
+     * Checks whether the output depends on earlier frames
+     * @return True if the plane denoisers are temporal
+     */
+    bool isTemporal() const override { return m_planes[0]->isTemporal(); }
+
+    /**
+     * Sets the brightness/contrast stage, translated to YCbCr and fused into each plane's output
+     * @param alpha Contrast gain
+     * @param beta Brightness offset
+     */
+    void setEnhancement(double alpha, double beta) override;
+
+    /**
+     * Gets the change detection counters; frames are counted on the luma plane, tiles on all planes
+     * @return Counters
+     */
+    SkipStats skipStats() const override;
+
+private:
+    std::unique_ptr<VideoDenoiser> m_planes[3];
+};
+
+/**
+ * Reuses earlier output for parts of the frame that have not changed
+ *
+ * Each frame is split into tiles and compared with the input the current
+ * output was computed from. Unchanged tiles keep their output; changed tiles
+ * are denoised again, one horizontal band per tile row with a halo so the
+ * band edges match a whole-frame call. Only stateless (spatial) denoisers can
+ * be wrapped, since they may see just part of a frame.
+ */
+class ChangeSkippingVideoDenoiser : public VideoDenoiser {
+public:
+    /**
+     * Constructor
+     * @param strength Denoising strength
+     * @param inner Spatial denoiser run on changed regions
+     * @param threshold Mean absolute difference per subpixel at or below which a tile counts as unchanged
+     */
+    ChangeSkippingVideoDenoiser(float strength, std::unique_ptr<VideoDenoiser> inner, double threshold);
+
+    /**
+     * Destructor
+     */
+    ~ChangeSkippingVideoDenoiser() override;
+
+    /**
+     * Initializes the wrapped denoiser, forgets the previous frame and clears the counters
+     * @param width Frame width
+     * @param height Frame height
+     */
+    void initialize(int width, int height) override;
+
+    using VideoDenoiser::denoise;
+
+    /**
+     * Denoises the parts of a frame that changed
+     * @param inputFrame Input frame
+     * @param outputFrame Receives the denoised frame
+     */
+    void denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) override;
+
+    /**
+     * Sets the brightness/contrast stage on the wrapped denoiser
+     * @param alpha Contrast gain
+     * @param beta Brightness offset
+     */
+    void setEnhancement(double alpha, double beta) override { m_inner->setEnhancement(alpha, beta); }
+
+    /**
+     * Checks whether the output depends on earlier frames
+     * @return Always true; unchanged tiles reuse the output of the previous frame
+     */
+    bool isTemporal() const override { return true; }
+
+    /**
+     * Gets the change detection counters
+     * @return Counters
+     */
+    SkipStats skipStats() const override { return m_stats; }
+
+private:
+    std::unique_ptr<VideoDenoiser> m_inner;
+    double m_threshold;
+    SkipStats m_stats;
+    cv::Mat m_reference;       // Input the current output was computed from, per tile
+    cv::Mat m_output;          // Output for the reference input
+    cv::Mat m_band;            // Denoised band of changed tiles
+    std::vector<uchar> m_changed;
 };
 
 /**
  * Factory function to create video denoiser
  * @param strength Denoising strength
+ * @param options Backend selection and backend parameters
  * @return Video denoiser instance
  */
-std::unique_ptr<VideoDenoiser> createVideoDenoiser(float strength);
\ No newline at end of file
+std::unique_ptr<VideoDenoiser> createVideoDenoiser(float strength,
+                                                   const VideoDenoiserOptions& options = VideoDenoiserOptions());
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "convolution.h"
+#include "dsp_target.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::unique_ptr<ConvolutionEngine> createConvolutionEngine(const std::vector<float>& taps) {
+    if (taps.size() >= kFftConvolutionMinTaps) {
+        return std::make_unique<OverlapSaveConvolution>(taps);
+    }
+    return std::make_unique<DirectConvolution>(taps);
+}
+
+DirectConvolution::DirectConvolution(const std::vector<float>& taps)
+    : m_reversedTaps(taps.rbegin(), taps.rend()) {
+    if (taps.empty()) {
+        throw std::invalid_argument("Convolution needs at least one tap");
+    }
+    reset();
+}
+
+void DirectConvolution::reset() {
+    m_workBuffer.assign(m_reversedTaps.size() - 1, 0.0f);
+}
+
+void DirectConvolution::process(const float* input, float* output, size_t count) {
+    const size_t historyLength = m_reversedTaps.size() - 1;
+
+    // The buffer always starts with the previous historyLength samples, which
+    // covers the warm-up region of a new stream with zeros.
+    m_workBuffer.resize(historyLength + count);
+    std::copy(input, input + count, m_workBuffer.begin() + historyLength);
+
+    firFilter(m_workBuffer.data(), m_reversedTaps.data(), m_reversedTaps.size(), output, count);
+
+    std::copy(m_workBuffer.end() - historyLength, m_workBuffer.end(), m_workBuffer.begin());
+    m_workBuffer.resize(historyLength);
+}
+
+static int choosePartitionSize(size_t numTaps) {
+    // One partition up to 1024 taps; longer filters are split so the FFT
+    // stays cache-resident and typical decoder-sized pushes fill whole blocks.
+    int size = 256;
+    while (size < static_cast<int>(numTaps) && size < 1024) {
+        size <<= 1;
+    }
+    return size;
+}
+
+OverlapSaveConvolution::OverlapSaveConvolution(const std::vector<float>& taps, int partitionSize)
+    : m_partitionSize(partitionSize > 0 ? partitionSize : choosePartitionSize(taps.size())),
+      m_numPartitions(0),
+      m_plan(2 * m_partitionSize) {
+
+    if (taps.empty()) {
+        throw std::invalid_argument("Convolution needs at least one tap");
+    }
+
+    const int fftSize = 2 * m_partitionSize;
+    const int numBins = m_partitionSize + 1;
+    m_numPartitions = static_cast<int>((taps.size() + m_partitionSize - 1) / m_partitionSize);
+
+    std::vector<float> padded(fftSize);
+    m_filterSpectra.resize(m_numPartitions);
+    for (int p = 0; p < m_numPartitions; p++) {
+        std::fill(padded.begin(), padded.end(), 0.0f);
+        for (int i = 0; i < m_partitionSize; i++) {
+            size_t tap = static_cast<size_t>(p) * m_partitionSize + i;
+            if (tap < taps.size()) {
+                padded[i] = taps[tap];
+            }
+        }
+        m_filterSpectra[p].resize(numBins);
+        m_plan.forwardReal(padded.data(), m_filterSpectra[p].data());
+    }
+
+    m_partialSpectrum.resize(numBins);
+    m_accumulator.resize(numBins);
+    m_outputWindow.resize(fftSize);
+    reset();
+}
+
+int OverlapSaveConvolution::partitionSize() const {
+    return m_partitionSize;
+}
+
+void OverlapSaveConvolution::reset() {
+    const int fftSize = 2 * m_partitionSize;
+    m_inputSpectra.assign(m_numPartitions, std::vector<std::complex<float>>(m_partitionSize + 1));
+    m_newestSpectrum = 0;
+    m_inputWindow.assign(fftSize, 0.0f);
+    m_blockFill = 0;
+    m_blockEmitted = 0;
+}
+
+void OverlapSaveConvolution::process(const float* input, float* output, size_t count) {
+    while (count > 0) {
+        int take = static_cast<int>(std::min<size_t>(count, m_partitionSize - m_blockFill));
+        std::copy(input, input + take, m_inputWindow.begin() + m_partitionSize + m_blockFill);
+        m_blockFill += take;
+        input += take;
+        count -= take;
+
+        bool blockComplete = (m_blockFill == m_partitionSize);
+        computeBlock(blockComplete);
+
+        // The last half of the circular result holds the valid samples
+        for (int i = m_blockEmitted; i < m_blockFill; i++) {
+            *output++ = m_outputWindow[m_partitionSize + i];
+        }
+        m_blockEmitted = m_blockFill;
+
+        if (blockComplete) {
+            std::copy(m_inputWindow.begin() + m_partitionSize, m_inputWindow.end(), m_inputWindow.begin());
+            std::fill(m_inputWindow.begin() + m_partitionSize, m_inputWindow.end(), 0.0f);
+            m_blockFill = 0;
+            m_blockEmitted = 0;
+        }
+    }
+}
+
+DSP_TARGET_CLONES
+void OverlapSaveConvolution::computeBlock(bool blockComplete) {
+    const int numBins = m_partitionSize + 1;
+
+    // A partially filled block is transformed with zeros in its missing tail,
+    // which gives exact output for the samples it does contain. It is only
+    // added to the delay line once complete.
+    std::vector<std::complex<float>>& current = blockComplete
+        ? m_inputSpectra[(m_newestSpectrum + 1) % m_numPartitions]
+        : m_partialSpectrum;
+    m_plan.forwardReal(m_inputWindow.data(), current.data());
+
+    if (blockComplete) {
+        m_newestSpectrum = (m_newestSpectrum + 1) % m_numPartitions;
+    }
+
+    // Partition 0 pairs with the current block, partition p with the block p steps back
+    int previous = blockComplete ? m_newestSpectrum - 1 : m_newestSpectrum;
+    for (int i = 0; i < numBins; i++) {
+        const std::complex<float>& x = current[i];
+        const std::complex<float>& h = m_filterSpectra[0][i];
+        float accRe = x.real() * h.real() - x.imag() * h.imag();
+        float accIm = x.real() * h.imag() + x.imag() * h.real();
+
+        for (int p = 1; p < m_numPartitions; p++) {
+            int slot = ((previous - (p - 1)) % m_numPartitions + m_numPartitions) % m_numPartitions;
+            const std::complex<float>& xp = m_inputSpectra[slot][i];
+            const std::complex<float>& hp = m_filterSpectra[p][i];
+            accRe += xp.real() * hp.real() - xp.imag() * hp.imag();
+            accIm += xp.real() * hp.imag() + xp.imag() * hp.real();
+        }
+
+        m_accumulator[i] = std::complex<float>(accRe, accIm);
+    }
+
+    m_plan.inverseReal(m_accumulator.data(), m_outputWindow.data());
+}
@@ -0,0 +1,790 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "convolution.h"
+#include "filters.h"
+#include "fir_kernel.h"
+
+// Counts every heap allocation so benchmarks can check their steady state
+static std::atomic<size_t> g_allocationCount{0};
+
+void* operator new(size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size > 0 ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+/**
+ * Streams synthetic mono input through a convolution engine
+ * @param engine Engine under test
+ * @param block Input block, pushed repeatedly
+ * @param totalSamples Number of samples to process
+ * @return Elapsed wall time in seconds
+ */
+static double timeEngine(ConvolutionEngine& engine, const std::vector<float>& block, size_t totalSamples) {
+    std::vector<float> output(block.size());
+    volatile float sink = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t processed = 0;
+    while (processed < totalSamples) {
+        size_t count = std::min(block.size(), totalSamples - processed);
+        engine.process(block.data(), output.data(), count);
+        sink = sink + output[0];
+        processed += count;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Original BandPassFilter loop, with a bounds check on every tap
+ */
+static void firFilterBaseline(const std::vector<float>& input, const std::vector<float>& taps, std::vector<float>& output) {
+    const int filterLength = static_cast<int>(taps.size());
+    const int inputLength = static_cast<int>(input.size());
+    for (int i = 0; i < inputLength; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < filterLength; j++) {
+            int inputIdx = i - j;
+            if (inputIdx >= 0 && inputIdx < inputLength) {
+                sum += input[inputIdx] * taps[j];
+            }
+        }
+        output[i] = sum;
+    }
+}
+
+static int runFirBench(double seconds, int sampleRate, int blockSize, const std::vector<int>& tapCounts) {
+    size_t totalSamples = static_cast<size_t>(seconds * sampleRate);
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    std::vector<float> block(blockSize);
+    for (auto& sample : block) {
+        sample = noise(rng);
+    }
+
+    std::cout << "FIR kernels: " << seconds << " s mono at " << sampleRate << " Hz, "
+              << blockSize << "-sample blocks, dispatched kernel: " << firKernelName() << std::endl;
+    std::cout << std::setw(8) << "taps" << std::setw(18) << "baseline ns/smp" << std::setw(16) << "scalar ns/smp"
+              << std::setw(16) << "simd ns/smp" << std::setw(12) << "speedup" << std::endl;
+
+    for (int taps : tapCounts) {
+        std::vector<float> coefficients(taps);
+        for (auto& c : coefficients) {
+            c = noise(rng);
+        }
+        std::vector<float> reversed(coefficients.rbegin(), coefficients.rend());
+        std::vector<float> padded(taps - 1 + blockSize, 0.0f);
+        std::copy(block.begin(), block.end(), padded.begin() + (taps - 1));
+        std::vector<float> output(blockSize);
+        volatile float sink = 0.0f;
+
+        auto timeLoop = [&](auto&& body) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t processed = 0; processed < totalSamples; processed += blockSize) {
+                body();
+                sink = sink + output[0];
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        double baselineSec = timeLoop([&] { firFilterBaseline(block, coefficients, output); });
+        double scalarSec = timeLoop([&] {
+            firFilterScalar(padded.data(), reversed.data(), reversed.size(), output.data(), output.size());
+        });
+        double simdSec = timeLoop([&] {
+            firFilter(padded.data(), reversed.data(), reversed.size(), output.data(), output.size());
+        });
+
+        std::cout << std::setw(8) << taps
+                  << std::setw(18) << std::fixed << std::setprecision(3) << baselineSec * 1e9 / totalSamples
+                  << std::setw(16) << scalarSec * 1e9 / totalSamples
+                  << std::setw(16) << simdSec * 1e9 / totalSamples
+                  << std::setw(11) << std::setprecision(2) << baselineSec / simdSec << "x" << std::endl;
+    }
+    return 0;
+}
+
+static int runConvolutionBench(double seconds, int sampleRate, int blockSize, const std::vector<int>& tapCounts) {
+    size_t totalSamples = static_cast<size_t>(seconds * sampleRate);
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    std::vector<float> block(blockSize);
+    for (auto& sample : block) {
+        sample = noise(rng);
+    }
+
+    std::cout << "Convolution crossover: " << seconds << " s mono at " << sampleRate << " Hz ("
+              << totalSamples << " samples), " << blockSize << "-sample blocks" << std::endl;
+    std::cout << std::setw(8) << "taps" << std::setw(16) << "direct ns/smp" << std::setw(16) << "fft ns/smp"
+              << std::setw(12) << "speedup" << std::setw(10) << "faster" << std::endl;
+
+    int crossover = -1;
+    for (int taps : tapCounts) {
+        std::vector<float> coefficients(taps);
+        for (auto& c : coefficients) {
+            c = noise(rng);
+        }
+
+        DirectConvolution direct(coefficients);
+        OverlapSaveConvolution overlapSave(coefficients);
+
+        double directSec = timeEngine(direct, block, totalSamples);
+        double fftSec = timeEngine(overlapSave, block, totalSamples);
+        bool fftFaster = fftSec < directSec;
+        if (fftFaster && crossover < 0) {
+            crossover = taps;
+        }
+
+        std::cout << std::setw(8) << taps
+                  << std::setw(16) << std::fixed << std::setprecision(3) << directSec * 1e9 / totalSamples
+                  << std::setw(16) << fftSec * 1e9 / totalSamples
+                  << std::setw(11) << std::setprecision(2) << directSec / fftSec << "x"
+                  << std::setw(10) << (fftFaster ? "fft" : "direct") << std::endl;
+    }
+
+    if (crossover > 0) {
+        std::cout << "FFT convolution wins from " << crossover << " taps (factory threshold: "
+                  << kFftConvolutionMinTaps << ")" << std::endl;
+    } else {
+        std::cout << "Direct convolution won at every tap count tested" << std::endl;
+    }
+    return 0;
+}
+
+static int runStftBench(double seconds, int sampleRate, int blockSize, const std::vector<int>& fftSizes,
+                        int numThreads) {
+    size_t totalSamples = static_cast<size_t>(seconds * sampleRate);
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    std::vector<float> block(blockSize);
+    for (auto& sample : block) {
+        sample = noise(rng);
+    }
+
+    std::cout << "Spectral subtraction STFT: " << seconds << " s mono at " << sampleRate << " Hz, "
+              << blockSize << "-sample blocks, " << numThreads << " thread(s)" << std::endl;
+    std::cout << std::setw(8) << "fft" << std::setw(12) << "ns/smp" << std::setw(20) << "steady-state allocs" << std::endl;
+
+    int status = 0;
+    for (int fftSize : fftSizes) {
+        SpectralSubtraction subtraction(sampleRate, fftSize, fftSize / 4, 0.5f, numThreads);
+        std::vector<float> output;
+        output.reserve(blockSize + fftSize);
+        volatile float sink = 0.0f;
+
+        // Warm up past the noise estimate and a few slice batches so the
+        // streaming buffers reach full size
+        size_t warmupSamples = static_cast<size_t>(sampleRate) * 5;
+        for (size_t processed = 0; processed < warmupSamples; processed += blockSize) {
+            output.clear();
+            subtraction.pushBlock(block.data(), block.size(), output);
+        }
+
+        size_t allocationsBefore = g_allocationCount.load();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t processed = 0; processed < totalSamples; processed += blockSize) {
+            output.clear();
+            subtraction.pushBlock(block.data(), block.size(), output);
+            sink = sink + (output.empty() ? 0.0f : output[0]);
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t allocations = g_allocationCount.load() - allocationsBefore;
+
+        std::cout << std::setw(8) << fftSize
+                  << std::setw(12) << std::fixed << std::setprecision(3) << elapsed * 1e9 / totalSamples
+                  << std::setw(20) << allocations << std::endl;
+        if (allocations > 0) {
+            status = 1;
+        }
+    }
+
+    if (status != 0) {
+        std::cerr << "Error: STFT loop allocated in steady state" << std::endl;
+    }
+    return status;
+}
+
+/**
+ * Deterministic test signal: three tones over white or pink noise
+ */
+class SyntheticSignal {
+public:
+    /**
+     * Constructor
+     * @param sampleRate Sample rate in Hz
+     * @param pinkNoise True for pink (1/f) noise, false for white noise
+     */
+    SyntheticSignal(int sampleRate, bool pinkNoise)
+        : m_sampleRate(sampleRate), m_pinkNoise(pinkNoise), m_rng(1234), m_noise(0.0f, 1.0f) {
+    }
+
+    /**
+     * Generates the next samples, continuing where the previous call stopped
+     * @param output Receives the samples
+     * @param count Number of samples
+     */
+    void generate(float* output, size_t count) {
+        static const double kTones[3][2] = {{220.0, 0.2}, {1000.0, 0.1}, {3000.0, 0.05}};
+        const double twoPi = 6.283185307179586;
+        for (size_t i = 0; i < count; i++) {
+            double t = static_cast<double>(m_position++) / m_sampleRate;
+            double sample = 0.0;
+            for (const auto& tone : kTones) {
+                sample += tone[1] * std::sin(twoPi * tone[0] * t);
+            }
+
+            float white = m_noise(m_rng);
+            if (m_pinkNoise) {
+                // Paul Kellet's pink noise filter, scaled to roughly unit variance
+                m_pink[0] = 0.99886f * m_pink[0] + white * 0.0555179f;
+                m_pink[1] = 0.99332f * m_pink[1] + white * 0.0750759f;
+                m_pink[2] = 0.96900f * m_pink[2] + white * 0.1538520f;
+                m_pink[3] = 0.86650f * m_pink[3] + white * 0.3104856f;
+                m_pink[4] = 0.55000f * m_pink[4] + white * 0.5329522f;
+                m_pink[5] = -0.7616f * m_pink[5] - white * 0.0168980f;
+                float pink = m_pink[0] + m_pink[1] + m_pink[2] + m_pink[3] + m_pink[4] + m_pink[5] + m_pink[6]
+                             + white * 0.5362f;
+                m_pink[6] = white * 0.115926f;
+                sample += 0.05 * pink / 3.5;
+            } else {
+                sample += 0.05 * white;
+            }
+            output[i] = static_cast<float>(sample);
+        }
+    }
+
+private:
+    int m_sampleRate;
+    bool m_pinkNoise;
+    std::mt19937 m_rng;
+    std::normal_distribution<float> m_noise;
+    uint64_t m_position = 0;
+    float m_pink[7] = {};
+};
+
+/**
+ * Resets the kernel's peak RSS counter to the current RSS
+ * @return True if the counter could be reset
+ */
+static bool resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.close();
+    return !clearRefs.fail();
+}
+
+/**
+ * Gets the peak resident set size since start or the last reset
+ * @return Peak RSS in KiB, or 0 if unavailable
+ */
+static long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Cost of one stage on one input configuration
+ */
+struct StageResult {
+    std::string stage;
+    std::string noise;
+    int sampleRate = 0;
+    double seconds = 0.0;        // Requested input length
+    double nsPerSample = 0.0;
+    double samplesPerSecond = 0.0;
+    long peakRssKb = 0;
+
+    /**
+     * Gets the key results are matched on against a baseline
+     * @return Stage, sample rate, input length and noise colour
+     */
+    std::string key() const {
+        std::ostringstream text;
+        text << stage << "@" << sampleRate << "Hz/" << seconds << "s/" << noise;
+        return text.str();
+    }
+};
+
+/**
+ * Times one stage run, keeping the fastest of several repeats
+ * @param stage Stage name
+ * @param sampleRate Sample rate of the input
+ * @param seconds Requested input length
+ * @param samples Samples the body processes per run
+ * @param repeats Number of runs
+ * @param body Stage body; may set up its own state
+ * @return Result
+ */
+template <typename Body>
+static StageResult timeStage(const std::string& stage, int sampleRate, double seconds, size_t samples, int repeats,
+                             Body&& body) {
+    resetPeakRss();
+    double best = 0.0;
+    for (int run = 0; run < repeats; run++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = (run == 0) ? elapsed : std::min(best, elapsed);
+    }
+
+    StageResult result;
+    result.stage = stage;
+    result.sampleRate = sampleRate;
+    result.seconds = seconds;
+    result.nsPerSample = best * 1e9 / samples;
+    result.samplesPerSecond = samples / best;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+/**
+ * Options for the stages benchmark
+ */
+struct StageBenchOptions {
+    std::vector<int> sampleRates = {16000, 44100, 48000, 96000};
+    std::vector<double> durations = {60.0};
+    bool pinkNoise = false;
+    int blockSize = 1024;
+    int numThreads = 1;
+    int repeats = 1;
+    double batchLimit = 600.0;   // Longest input the whole-buffer APIs are given
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 10.0;     // Allowed slowdown against the baseline in percent
+};
+
+static std::vector<StageResult> runStages(int sampleRate, double seconds, const StageBenchOptions& options) {
+    // The app's defaults, with the upper cutoff kept below Nyquist at low rates
+    const float lowCutoff = 100.0f;
+    const float highCutoff = std::min(8000.0f, 0.45f * sampleRate);
+    const float reduction = 0.5f;
+    const size_t totalSamples = static_cast<size_t>(seconds * sampleRate);
+    const size_t blockSize = static_cast<size_t>(options.blockSize);
+
+    // Streaming stages cycle through one second of signal, so their peak RSS
+    // shows the filters' working set rather than the input. The whole-buffer
+    // input is only generated once they are done.
+    size_t loopSamples = std::min(totalSamples, static_cast<size_t>(sampleRate));
+    size_t batchSamples = std::min(totalSamples, static_cast<size_t>(options.batchLimit * sampleRate));
+    std::vector<float> source(loopSamples);
+    SyntheticSignal(sampleRate, options.pinkNoise).generate(source.data(), source.size());
+
+    std::vector<float> block(blockSize);
+    volatile float sink = 0.0f;
+    auto streamBlocks = [&](auto&& pushBlock) {
+        size_t offset = 0;
+        for (size_t processed = 0; processed < totalSamples; processed += blockSize) {
+            size_t count = std::min(blockSize, totalSamples - processed);
+            if (offset + count > loopSamples) {
+                offset = 0;
+            }
+            pushBlock(source.data() + offset, count);
+            offset += count;
+        }
+    };
+
+    std::vector<StageResult> results;
+    results.push_back(timeStage("bandpass_stream", sampleRate, seconds, totalSamples, options.repeats, [&] {
+        BandPassFilter filter(sampleRate, lowCutoff, highCutoff);
+        streamBlocks([&](const float* input, size_t count) {
+            filter.process(input, block.data(), count);
+            sink = sink + block[0];
+        });
+    }));
+
+    results.push_back(timeStage("stft_stream", sampleRate, seconds, totalSamples, options.repeats, [&] {
+        SpectralSubtraction subtraction(sampleRate, 2048, 512, reduction, options.numThreads);
+        std::vector<float> output;
+        streamBlocks([&](const float* input, size_t count) {
+            output.clear();
+            subtraction.pushBlock(input, count, output);
+            sink = sink + (output.empty() ? 0.0f : output[0]);
+        });
+        output.clear();
+        subtraction.flush(output);
+    }));
+
+    results.push_back(timeStage("chain_stream", sampleRate, seconds, totalSamples, options.repeats, [&] {
+        AudioProcessor processor(sampleRate, lowCutoff, highCutoff, reduction, options.numThreads);
+        std::vector<float> output;
+        streamBlocks([&](const float* input, size_t count) {
+            output.clear();
+            processor.pushBlock(input, count, output);
+            sink = sink + (output.empty() ? 0.0f : output[0]);
+        });
+        output.clear();
+        processor.flush(output);
+    }));
+
+    source = std::vector<float>();
+    std::vector<float> batch(batchSamples);
+    SyntheticSignal(sampleRate, options.pinkNoise).generate(batch.data(), batch.size());
+    const double batchSeconds = static_cast<double>(batchSamples) / sampleRate;
+
+    results.push_back(timeStage("bandpass_apply", sampleRate, seconds, batchSamples, options.repeats, [&] {
+        BandPassFilter filter(sampleRate, lowCutoff, highCutoff);
+        std::vector<float> output = filter.apply(batch);
+        sink = sink + output.back();
+    }));
+
+    results.push_back(timeStage("noise_profile", sampleRate, seconds, batchSamples, options.repeats, [&] {
+        SpectralSubtraction subtraction(sampleRate, 2048, 512, reduction, options.numThreads);
+        std::vector<float> profile = subtraction.estimateNoiseProfile(batch, static_cast<float>(batchSeconds));
+        sink = sink + profile[0];
+    }));
+
+    results.push_back(timeStage("stft_process", sampleRate, seconds, batchSamples, options.repeats, [&] {
+        SpectralSubtraction subtraction(sampleRate, 2048, 512, reduction, options.numThreads);
+        std::vector<float> output = subtraction.process(batch);
+        sink = sink + output.back();
+    }));
+
+    results.push_back(timeStage("chain_process", sampleRate, seconds, batchSamples, options.repeats, [&] {
+        AudioProcessor processor(sampleRate, lowCutoff, highCutoff, reduction, options.numThreads);
+        std::vector<float> output = processor.process(batch);
+        sink = sink + output.back();
+    }));
+
+    return results;
+}
+
+static bool writeStageJson(const std::string& path, const std::vector<StageResult>& results,
+                           const StageBenchOptions& options) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    // One result per line, which is also what readStageBaseline() expects
+    file << std::setprecision(9);
+    file << "{\n  \"noise\": \"" << (options.pinkNoise ? "pink" : "white") << "\",\n";
+    file << "  \"block\": " << options.blockSize << ",\n";
+    file << "  \"threads\": " << options.numThreads << ",\n";
+    file << "  \"fir_kernel\": \"" << firKernelName() << "\",\n";
+    file << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const StageResult& result = results[i];
+        file << "    {\"key\": \"" << result.key() << "\", \"stage\": \"" << result.stage
+             << "\", \"sample_rate\": " << result.sampleRate << ", \"seconds\": " << result.seconds
+             << ", \"ns_per_sample\": " << result.nsPerSample
+             << ", \"samples_per_second\": " << result.samplesPerSecond
+             << ", \"peak_rss_kb\": " << result.peakRssKb << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+/**
+ * Reads ns/sample and peak RSS per result key from a file written by writeStageJson()
+ * @param path Baseline file
+ * @param baseline Receives the values
+ * @return True if the file could be read
+ */
+static bool readStageBaseline(const std::string& path, std::map<std::string, StageResult>& baseline) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open baseline " << path << std::endl;
+        return false;
+    }
+
+    const std::string keyField = "\"key\": \"";
+    const std::string nsField = "\"ns_per_sample\": ";
+    const std::string rssField = "\"peak_rss_kb\": ";
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t keyPos = line.find(keyField);
+        size_t nsPos = line.find(nsField);
+        size_t rssPos = line.find(rssField);
+        if (keyPos == std::string::npos || nsPos == std::string::npos) {
+            continue;
+        }
+        keyPos += keyField.size();
+        std::string key = line.substr(keyPos, line.find('"', keyPos) - keyPos);
+        StageResult& entry = baseline[key];
+        entry.nsPerSample = std::atof(line.c_str() + nsPos + nsField.size());
+        if (rssPos != std::string::npos) {
+            entry.peakRssKb = std::atol(line.c_str() + rssPos + rssField.size());
+        }
+    }
+    return true;
+}
+
+static int runStageBench(const StageBenchOptions& options) {
+    std::cout << "Audio DSP stages: " << (options.pinkNoise ? "pink" : "white") << " noise plus tones, "
+              << options.blockSize << "-sample blocks, " << options.numThreads << " STFT thread(s), best of "
+              << options.repeats << ", FIR kernel: " << firKernelName() << std::endl;
+    if (!resetPeakRss()) {
+        std::cout << "Note: peak RSS cannot be reset here, so it is the process peak so far" << std::endl;
+    }
+
+    std::map<std::string, StageResult> baseline;
+    if (!options.baselinePath.empty() && !readStageBaseline(options.baselinePath, baseline)) {
+        return 1;
+    }
+
+    std::vector<StageResult> results;
+    int regressions = 0;
+    for (int sampleRate : options.sampleRates) {
+        for (double seconds : options.durations) {
+            std::cout << std::defaultfloat << std::setprecision(6) << sampleRate << " Hz, " << seconds << " s:" << std::endl;
+            std::cout << std::setw(18) << "stage" << std::setw(16) << "Msamples/s" << std::setw(12) << "ns/smp"
+                      << std::setw(14) << "peak RSS MB";
+            if (!baseline.empty()) {
+                std::cout << std::setw(12) << "vs base";
+            }
+            std::cout << std::endl;
+
+            for (StageResult& result : runStages(sampleRate, seconds, options)) {
+                result.noise = options.pinkNoise ? "pink" : "white";
+                std::cout << std::setw(18) << result.stage
+                          << std::setw(16) << std::fixed << std::setprecision(2) << result.samplesPerSecond / 1e6
+                          << std::setw(12) << std::setprecision(3) << result.nsPerSample
+                          << std::setw(14) << std::setprecision(1) << result.peakRssKb / 1024.0;
+                auto match = baseline.find(result.key());
+                if (match != baseline.end() && match->second.nsPerSample > 0) {
+                    double change = 100.0 * (result.nsPerSample / match->second.nsPerSample - 1.0);
+                    bool regressed = change > options.tolerance;
+                    std::cout << std::setw(11) << std::showpos << change << std::noshowpos << "%"
+                              << (regressed ? "  REGRESSION" : "");
+
+                    // Peak RSS is held to the same tolerance, so a streaming
+                    // stage that starts buffering its input is caught too
+                    long baseRss = match->second.peakRssKb;
+                    bool rssRegressed = baseRss > 0 && result.peakRssKb > baseRss * (1.0 + options.tolerance / 100.0);
+                    if (rssRegressed) {
+                        std::cout << "  RSS " << std::showpos << 100.0 * (static_cast<double>(result.peakRssKb) / baseRss - 1.0)
+                                  << std::noshowpos << "%";
+                    }
+                    regressions += (regressed || rssRegressed) ? 1 : 0;
+                }
+                std::cout << std::endl;
+                results.push_back(std::move(result));
+            }
+            if (seconds > options.batchLimit) {
+                std::cout << std::defaultfloat << std::setprecision(6) << "  (whole-buffer stages ran on the first " << options.batchLimit
+                          << " s)" << std::endl;
+            }
+        }
+    }
+
+    if (!options.jsonPath.empty()) {
+        if (!writeStageJson(options.jsonPath, results, options)) {
+            return 1;
+        }
+        std::cout << "Results written to " << options.jsonPath << std::endl;
+    }
+
+    if (regressions > 0) {
+        std::cerr << "Error: " << regressions << " stage(s) slower or larger than the baseline by more than "
+                  << options.tolerance << "%" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static void printUsage(const char* programName) {
+    std::cout << "Video Cleaner DSP benchmarks" << std::endl;
+    std::cout << "Usage: " << programName << " <convolution|fir|stft|stages> [options]" << std::endl;
+    std::cout << "Benchmarks:" << std::endl;
+    std::cout << "  convolution         : Direct vs FFT convolution crossover" << std::endl;
+    std::cout << "  fir                 : Original FIR loop vs scalar and SIMD kernels" << std::endl;
+    std::cout << "  stft                : Streaming spectral subtraction cost and allocations" << std::endl;
+    std::cout << "  stages              : Throughput and peak RSS of every DSP stage on synthetic tones plus noise" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --seconds <s>       : Length of synthetic input (default: 3600)" << std::endl;
+    std::cout << "  --sample-rate <Hz>  : Sample rate of synthetic input (default: 48000)" << std::endl;
+    std::cout << "  --block <samples>   : Samples pushed per call (default: 1024)" << std::endl;
+    std::cout << "  --taps <n,n,...>    : Tap counts to compare (default: 16,65,128,256,512,1024,2048,4096)" << std::endl;
+    std::cout << "  --fft <n,n,...>     : FFT sizes for stft (default: 512,1024,2048,4096)" << std::endl;
+    std::cout << "  --threads <n>       : Time slices for stft and stages (default: 1)" << std::endl;
+    std::cout << "Options for stages:" << std::endl;
+    std::cout << "  --rates <Hz,...>    : Sample rates (default: 16000,44100,48000,96000)" << std::endl;
+    std::cout << "  --durations <s,...> : Input lengths in seconds (default: 60)" << std::endl;
+    std::cout << "  --noise <white|pink>: Noise colour (default: white)" << std::endl;
+    std::cout << "  --repeat <n>        : Runs per stage, fastest is kept (default: 1)" << std::endl;
+    std::cout << "  --batch-limit <s>   : Longest input given to the whole-buffer APIs (default: 600)" << std::endl;
+    std::cout << "  --json <path>       : Write results as JSON" << std::endl;
+    std::cout << "  --baseline <path>   : Compare with a --json file; exits 1 on a regression" << std::endl;
+    std::cout << "  --tolerance <pct>   : Slowdown and peak RSS growth allowed against the baseline (default: 10)" << std::endl;
+}
+
+static std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = text.size();
+        }
+        values.push_back(std::stoi(text.substr(pos, comma - pos)));
+        pos = comma + 1;
+    }
+    return values;
+}
+
+static std::vector<double> parseDoubleList(const std::string& text) {
+    std::vector<double> values;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = text.size();
+        }
+        values.push_back(std::stod(text.substr(pos, comma - pos)));
+        pos = comma + 1;
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+        printUsage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+
+    std::string mode = argv[1];
+    double seconds = 3600.0;
+    int sampleRate = 48000;
+    int blockSize = 1024;
+    std::vector<int> tapCounts = {16, 65, 128, 256, 512, 1024, 2048, 4096};
+    std::vector<int> fftSizes = {512, 1024, 2048, 4096};
+    int numThreads = 1;
+    StageBenchOptions stageOptions;
+
+    try {
+        int argIdx = 2;
+        while (argIdx < argc) {
+            if (strcmp(argv[argIdx], "--seconds") == 0 && argIdx + 1 < argc) {
+                seconds = std::stod(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--sample-rate") == 0 && argIdx + 1 < argc) {
+                sampleRate = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--block") == 0 && argIdx + 1 < argc) {
+                blockSize = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--taps") == 0 && argIdx + 1 < argc) {
+                tapCounts = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--fft") == 0 && argIdx + 1 < argc) {
+                fftSizes = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--threads") == 0 && argIdx + 1 < argc) {
+                numThreads = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--rates") == 0 && argIdx + 1 < argc) {
+                stageOptions.sampleRates = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--durations") == 0 && argIdx + 1 < argc) {
+                stageOptions.durations = parseDoubleList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--noise") == 0 && argIdx + 1 < argc) {
+                std::string noise = argv[argIdx + 1];
+                if (noise != "white" && noise != "pink") {
+                    std::cerr << "Error: Noise must be 'white' or 'pink'" << std::endl;
+                    return 1;
+                }
+                stageOptions.pinkNoise = noise == "pink";
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--repeat") == 0 && argIdx + 1 < argc) {
+                stageOptions.repeats = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--batch-limit") == 0 && argIdx + 1 < argc) {
+                stageOptions.batchLimit = std::stod(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--json") == 0 && argIdx + 1 < argc) {
+                stageOptions.jsonPath = argv[argIdx + 1];
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--baseline") == 0 && argIdx + 1 < argc) {
+                stageOptions.baselinePath = argv[argIdx + 1];
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--tolerance") == 0 && argIdx + 1 < argc) {
+                stageOptions.tolerance = std::stod(argv[argIdx + 1]);
+                argIdx += 2;
+            } else {
+                std::cerr << "Unexpected argument: " << argv[argIdx] << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (seconds <= 0 || sampleRate <= 0 || blockSize <= 0 || tapCounts.empty() || fftSizes.empty() ||
+            numThreads <= 0) {
+            std::cerr << "Error: Benchmark parameters must be positive" << std::endl;
+            return 1;
+        }
+
+        if (mode == "convolution") {
+            return runConvolutionBench(seconds, sampleRate, blockSize, tapCounts);
+        }
+        if (mode == "fir") {
+            return runFirBench(seconds, sampleRate, blockSize, tapCounts);
+        }
+        if (mode == "stft") {
+            return runStftBench(seconds, sampleRate, blockSize, fftSizes, numThreads);
+        }
+        if (mode == "stages") {
+            stageOptions.blockSize = blockSize;
+            stageOptions.numThreads = numThreads;
+            for (int rate : stageOptions.sampleRates) {
+                if (rate < 4000) {
+                    std::cerr << "Error: Sample rates must be at least 4000 Hz" << std::endl;
+                    return 1;
+                }
+            }
+            for (double duration : stageOptions.durations) {
+                if (duration <= 0) {
+                    std::cerr << "Error: Durations must be positive" << std::endl;
+                    return 1;
+                }
+            }
+            if (stageOptions.repeats <= 0 || stageOptions.batchLimit <= 0 || stageOptions.tolerance < 0) {
+                std::cerr << "Error: Benchmark parameters must be positive" << std::endl;
+                return 1;
+            }
+            return runStageBench(stageOptions);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Unknown benchmark: " << mode << std::endl;
+    printUsage(argv[0]);
+    return 1;
+}
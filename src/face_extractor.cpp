@@ -1,6 +1,13 @@
 #include "face_extractor.h"
+#include "bounded_queue.h"
 
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -12,10 +19,23 @@
 
 namespace fs = std::filesystem;
 
-FaceExtractor::FaceExtractor() {
-    std::string cascadePath = "data/haarcascade_frontalface_default.xml";
-    if (!m_faceClassifier.load(cascadePath)) {
-        std::cerr << "Error loading face cascade classifier: " << cascadePath << std::endl;
+// A sampled frame on its way from the decoder to a detector worker
+struct SampledFrame {
+    size_t index = 0;   // Position among the frames read, for the writer's reorder buffer
+    float time = 0.0f;
+    cv::Mat frame;
+};
+
+// A frame and its detections on their way to the writer
+struct DetectedFaces {
+    float time = 0.0f;
+    cv::Mat frame;
+    std::vector<cv::Rect> faces;
+};
+
+FaceExtractor::FaceExtractor() : m_cascadePath("data/haarcascade_frontalface_default.xml") {
+    if (!m_faceClassifier.load(m_cascadePath)) {
+        std::cerr << "Error loading face cascade classifier: " << m_cascadePath << std::endl;
         std::cerr << "Please ensure the file exists at the specified path relative to the executable or project root." << std::endl;
         m_initialized = false;
         return;
@@ -27,12 +47,12 @@ bool FaceExtractor::isInitialized() const {
     return m_initialized;
 }
 
-bool FaceExtractor::extractFaces(const std::string& videoPath, float timeInSeconds, const std::string& outputDir) {
-    if (!m_initialized) {
-        std::cerr << "Face extractor not properly initialized. Face detection model might be missing." << std::endl;
-        return false;
-    }
+// Seeking with CAP_PROP_POS_FRAMES decodes from the previous keyframe, so it
+// only beats decoding the gap with grab() once the gap is longer than a GOP.
+// 250 frames is the default keyframe interval of x264 and FFmpeg's encoders.
+static const int kSeekGapFrames = 250;
 
+bool FaceExtractor::createOutputDir(const std::string& outputDir) const {
     try {
         if (!fs::exists(outputDir)) {
             fs::create_directories(outputDir);
@@ -41,6 +61,53 @@ bool FaceExtractor::extractFaces(const std::string& videoPath, float timeInSecon
         std::cerr << "Error creating output directory '" << outputDir << "': " << e.what() << std::endl;
         return false;
     }
+    return true;
+}
+
+void FaceExtractor::writeFaces(const cv::Mat& frame, const std::vector<cv::Rect>& faces, float timeInSeconds,
+                               const std::string& videoPath, const std::string& outputDir) const {
+    if (faces.empty()) {
+        std::cout << "No faces detected at timestamp " << timeInSeconds << "s in video " << videoPath << std::endl;
+        return;
+    }
+
+    for (size_t i = 0; i < faces.size(); i++) {
+        cv::Rect faceRect = faces[i];
+        if (faceRect.x < 0) faceRect.x = 0;
+        if (faceRect.y < 0) faceRect.y = 0;
+        if (faceRect.x + faceRect.width > frame.cols) faceRect.width = frame.cols - faceRect.x;
+        if (faceRect.y + faceRect.height > frame.rows) faceRect.height = frame.rows - faceRect.y;
+
+        if (faceRect.width <= 0 || faceRect.height <= 0) continue;
+
+        cv::Mat faceROI = frame(faceRect);
+
+        fs::path outputDirPath(outputDir);
+        std::ostringstream oss;
+        oss << "face_" << std::fixed << std::setprecision(2) << timeInSeconds
+            << "s_" << i << ".jpg";
+        std::string filename = oss.str();
+        fs::path outputPath = outputDirPath / filename;
+
+        if (!cv::imwrite(outputPath.string(), faceROI)) {
+            std::cerr << "Error saving face " << i+1 << " to " << outputPath.string() << std::endl;
+        } else {
+            std::cout << "Saved face " << i+1 << " to " << outputPath.string() << std::endl;
+        }
+    }
+
+    std::cout << "Extracted " << faces.size() << " faces at timestamp " << timeInSeconds << "s from video " << videoPath << std::endl;
+}
+
+bool FaceExtractor::extractFaces(const std::string& videoPath, float timeInSeconds, const std::string& outputDir) {
+    if (!m_initialized) {
+        std::cerr << "Face extractor not properly initialized. Face detection model might be missing." << std::endl;
+        return false;
+    }
+
+    if (!createOutputDir(outputDir)) {
+        return false;
+    }
 
     cv::VideoCapture video(videoPath);
     if (!video.isOpened()) {
@@ -75,43 +142,12 @@ bool FaceExtractor::extractFaces(const std::string& videoPath, float timeInSecon
     }
     video.release();
 
-    std::vector<cv::Rect> faces = detectFaces(frame);
-    if (faces.empty()) {
-        std::cout << "No faces detected at timestamp " << timeInSeconds << "s in video " << videoPath << std::endl;
-        return true;
-    }
-
-    for (size_t i = 0; i < faces.size(); i++) {
-        cv::Rect faceRect = faces[i];
-        if (faceRect.x < 0) faceRect.x = 0;
-        if (faceRect.y < 0) faceRect.y = 0;
-        if (faceRect.x + faceRect.width > frame.cols) faceRect.width = frame.cols - faceRect.x;
-        if (faceRect.y + faceRect.height > frame.rows) faceRect.height = frame.rows - faceRect.y;
-
-        if (faceRect.width <= 0 || faceRect.height <= 0) continue;
-
-        cv::Mat faceROI = frame(faceRect);
-
-        fs::path outputDirPath(outputDir);
-        std::ostringstream oss;
-        oss << "face_" << std::fixed << std::setprecision(2) << timeInSeconds
-            << "s_" << i << ".jpg";
-        std::string filename = oss.str();
-        fs::path outputPath = outputDirPath / filename;
-
-        if (!cv::imwrite(outputPath.string(), faceROI)) {
-            std::cerr << "Error saving face " << i+1 << " to " << outputPath.string() << std::endl;
-        } else {
-            std::cout << "Saved face " << i+1 << " to " << outputPath.string() << std::endl;
-        }
-    }
-
-    std::cout << "Extracted " << faces.size() << " faces at timestamp " << timeInSeconds << "s from video " << videoPath << std::endl;
+    writeFaces(frame, detectFaces(frame, m_faceClassifier), timeInSeconds, videoPath, outputDir);
     return true;
 }
     
 bool FaceExtractor::extractFacesFromRange(const std::string& videoPath, float startTime, float endTime,
-                                          float interval, const std::string& outputDir) {
+                                          float interval, const std::string& outputDir, int jobs) {
     if (!m_initialized) {
         std::cerr << "Face extractor not properly initialized. Face detection model might be missing." << std::endl;
         return false;
@@ -122,14 +158,19 @@ bool FaceExtractor::extractFacesFromRange(const std::string& videoPath, float st
         return false;
     }
 
-    cv::VideoCapture video_check(videoPath);
-    if (!video_check.isOpened()) {
-        std::cerr << "Error: Could not open video file for range check: " << videoPath << std::endl;
+    if (jobs < 1) {
+        std::cerr << "Error: Number of detection jobs must be at least 1." << std::endl;
         return false;
     }
-    double fps = video_check.get(cv::CAP_PROP_FPS);
-    double totalFrames = video_check.get(cv::CAP_PROP_FRAME_COUNT);
-    video_check.release();
+
+    // The file is opened once and walked forward; every timestamp reuses the same decoder
+    cv::VideoCapture video(videoPath);
+    if (!video.isOpened()) {
+        std::cerr << "Error: Could not open video file: " << videoPath << std::endl;
+        return false;
+    }
+    double fps = video.get(cv::CAP_PROP_FPS);
+    double totalFrames = video.get(cv::CAP_PROP_FRAME_COUNT);
 
     if (fps == 0) {
         std::cerr << "Error: Could not get FPS from video (or FPS is 0). Cannot process range." << std::endl;
@@ -144,43 +185,205 @@ bool FaceExtractor::extractFacesFromRange(const std::string& videoPath, float st
         return false;
     }
 
-    bool all_successful = true;
+    if (!createOutputDir(outputDir)) {
+        return false;
+    }
 
+    std::vector<float> timestamps;
     if (startTime == endTime) {
-        std::cout << "--- Processing timestamp: " << startTime << "s ---" << std::endl;
-        if (!extractFaces(videoPath, startTime, outputDir)) {
+        timestamps.push_back(startTime);
+    } else {
+        int numSteps = static_cast<int>((endTime - startTime) / interval);
+        for (int step = 0; step <= numSteps; step++) {
+            timestamps.push_back(startTime + step * interval);
+        }
+
+        float epsilon = interval * 0.01f;
+        if (timestamps.back() < endTime - epsilon) {
+            timestamps.push_back(endTime);
+        }
+    }
+
+    // Results are reported on one thread and in timestamp order, so the log
+    // reads the same for any number of jobs
+    bool all_successful = true;
+    auto onDetected = [&](float time, const cv::Mat& frame, const std::vector<cv::Rect>& faces) {
+        std::cout << "--- Processing timestamp: " << time << "s (Range: " << startTime << "-" << endTime << ", Interval: " << interval << ") ---" << std::endl;
+        if (frame.empty()) {
+            std::cerr << "Error: Could not read frame or frame is empty at timestamp " << time << "s from video " << videoPath << std::endl;
+            std::cerr << "Failed to extract faces at timestamp " << time << "s. Continuing with next interval." << std::endl;
             all_successful = false;
-            std::cerr << "Failed to extract faces at timestamp " << startTime << "s." << std::endl;
+            return;
         }
+        writeFaces(frame, faces, time, videoPath, outputDir);
+    };
+
+    DecodeStats stats;
+    bool completed;
+    if (jobs == 1) {
+        completed = decodeSampledFrames(video, timestamps, fps, totalFrames,
+            [&](float time, const cv::Mat& frame) {
+                onDetected(time, frame, frame.empty() ? std::vector<cv::Rect>() : detectFaces(frame, m_faceClassifier));
+                return true;
+            }, stats);
     } else {
-        int numSteps = static_cast<int>((endTime - startTime) / interval);
-        float lastProcessedTime = -1.0f;
+        completed = detectInParallel(video, timestamps, fps, totalFrames, jobs, onDetected, stats);
+    }
+    video.release();
 
-        for (int step = 0; step <= numSteps; step++) {
-            float time = startTime + step * interval;
-            std::cout << "--- Processing timestamp: " << time << "s (Range: " << startTime << "-" << endTime << ", Interval: " << interval << ") ---" << std::endl;
-            if (!extractFaces(videoPath, time, outputDir)) {
-                all_successful = false;
-                std::cerr << "Failed to extract faces at timestamp " << time << "s. Continuing with next interval." << std::endl;
+    std::cout << "Decoded " << stats.framesGrabbed << " frames for " << timestamps.size() << " timestamps ("
+              << stats.seeks << " seeks)" << std::endl;
+    std::cout << "--- Face extraction from range completed for video " << videoPath << " --- " << std::endl;
+    return completed && all_successful;
+}
+
+bool FaceExtractor::decodeSampledFrames(cv::VideoCapture& video, const std::vector<float>& timestamps, double fps,
+                                        double totalFrames, const SampledFrameHandler& onFrame, DecodeStats& stats) {
+    int nextFrame = 0;         // Index of the frame the next grab() returns
+    int retrievedFrame = -1;   // Index of the frame held in 'frame'
+    cv::Mat frame;
+
+    for (float time : timestamps) {
+        // A timestamp at the very end of the video maps to the last frame
+        int targetFrame = std::min(static_cast<int>(time * fps), std::max(0, static_cast<int>(totalFrames) - 1));
+
+        if (targetFrame != retrievedFrame) {
+            if (targetFrame < nextFrame || targetFrame - nextFrame > kSeekGapFrames) {
+                video.set(cv::CAP_PROP_POS_FRAMES, targetFrame);
+                nextFrame = targetFrame;
+                stats.seeks++;
+            }
+
+            // grab() decodes without converting, so skipped frames cost no color conversion
+            bool grabbed = true;
+            while (grabbed && nextFrame <= targetFrame) {
+                grabbed = video.grab();
+                nextFrame++;
+                stats.framesGrabbed++;
+            }
+
+            // The handler may still hold the previous frame, so retrieve() gets a fresh buffer
+            frame.release();
+            if (!grabbed || !video.retrieve(frame) || frame.empty()) {
+                frame.release();
+
+                // The decoder position is unknown after a failed read, so the next timestamp seeks
+                retrievedFrame = -1;
+                nextFrame = std::numeric_limits<int>::max();
+            } else {
+                retrievedFrame = targetFrame;
             }
-            lastProcessedTime = time;
         }
 
-        float epsilon = interval * 0.01f;
-        if (lastProcessedTime < endTime - epsilon) {
-            std::cout << "--- Processing timestamp: " << endTime << "s (Range: " << startTime << "-" << endTime << ", Interval: " << interval << ") ---" << std::endl;
-            if (!extractFaces(videoPath, endTime, outputDir)) {
-                all_successful = false;
-                std::cerr << "Failed to extract faces at end timestamp " << endTime << "s." << std::endl;
+        if (!onFrame(time, frame)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FaceExtractor::detectInParallel(cv::VideoCapture& video, const std::vector<float>& timestamps, double fps,
+                                     double totalFrames, int jobs, const DetectionHandler& onDetected,
+                                     DecodeStats& stats) {
+    // Queue depths are tied to the worker count so at most a few decoded
+    // frames per worker are held in memory.
+    const size_t queueDepth = static_cast<size_t>(jobs) * 2;
+    BoundedQueue<SampledFrame> sampledFrames(queueDepth);
+    ReorderBuffer<DetectedFaces> detections(queueDepth);
+
+    std::atomic<bool> failed(false);
+    std::atomic<int> activeWorkers(jobs);
+    std::mutex errorMutex;
+    std::string errorMessage;
+
+    auto abortPipeline = [&](const std::string& message) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (errorMessage.empty()) {
+                errorMessage = message;
             }
         }
+        failed = true;
+        sampledFrames.close();
+        detections.close();
+    };
+
+    std::vector<std::thread> workers;
+    std::future<void> writer;
+    bool decodeOk = false;
+    try {
+        // cv::CascadeClassifier is not safe to share between threads, so every
+        // worker loads its own copy.
+        workers.reserve(jobs);
+        for (int w = 0; w < jobs; w++) {
+            workers.emplace_back([&]() {
+                try {
+                    cv::CascadeClassifier classifier;
+                    if (!classifier.load(m_cascadePath)) {
+                        abortPipeline("Error loading face cascade classifier: " + m_cascadePath);
+                    } else {
+                        SampledFrame item;
+                        while (sampledFrames.pop(item)) {
+                            std::vector<cv::Rect> faces;
+                            if (!item.frame.empty()) {
+                                faces = detectFaces(item.frame, classifier);
+                            }
+                            if (!detections.push(item.index, {item.time, std::move(item.frame), std::move(faces)})) {
+                                break;
+                            }
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    abortPipeline(std::string("Face detection worker failed: ") + e.what());
+                }
+
+                if (--activeWorkers == 0) {
+                    detections.close();
+                }
+            });
+        }
+
+        // Results are handed over in timestamp order on their own thread, so
+        // JPEG encoding overlaps detection.
+        writer = std::async(std::launch::async, [&]() {
+            try {
+                DetectedFaces result;
+                while (detections.pop(result)) {
+                    onDetected(result.time, result.frame, result.faces);
+                }
+            } catch (const std::exception& e) {
+                abortPipeline(std::string("Face writer failed: ") + e.what());
+            }
+        });
+
+        size_t index = 0;
+        decodeOk = decodeSampledFrames(video, timestamps, fps, totalFrames,
+            [&](float time, const cv::Mat& frame) {
+                return sampledFrames.push({index++, time, frame});
+            }, stats);
+    } catch (const std::exception& e) {
+        // Workers that never started never close the reorder buffer, so the
+        // abort closes both queues before anything is joined
+        abortPipeline(std::string("Face extraction failed: ") + e.what());
     }
+    sampledFrames.close();
 
-    std::cout << "--- Face extraction from range completed for video " << videoPath << " --- " << std::endl;
-    return all_successful;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (writer.valid()) {
+        writer.get();
+    }
+
+    if (failed) {
+        std::cerr << errorMessage << std::endl;
+        return false;
+    }
+    return decodeOk;
 }
 
-std::vector<cv::Rect> FaceExtractor::detectFaces(const cv::Mat& frame) {
+std::vector<cv::Rect> FaceExtractor::detectFaces(const cv::Mat& frame, cv::CascadeClassifier& classifier) const {
     std::vector<cv::Rect> faces_detected;
     if (frame.empty()) {
         std::cerr << "Cannot detect faces in an empty frame." << std::endl;
@@ -191,7 +394,7 @@ std::vector<cv::Rect> FaceExtractor::detectFaces(const cv::Mat& frame) {
     cv::cvtColor(frame, grayFrame, cv::COLOR_BGR2GRAY);
     cv::equalizeHist(grayFrame, grayFrame);
 
-    m_faceClassifier.detectMultiScale(
+    classifier.detectMultiScale(
         grayFrame, faces_detected,
         1.1,
         3,
@@ -206,10 +409,13 @@ void printUsage(const char* programName) {
     std::cout << "Face Extractor - Extracts faces from a video at specific timestamps or ranges." << std::endl;
     std::cout << "Usage:" << std::endl;
     std::cout << "  " << programName << " <video_path> <timestamp_seconds> <output_directory>" << std::endl;
-    std::cout << "  " << programName << " --range <video_path> <start_time_seconds> <end_time_seconds> <interval_seconds> <output_directory>" << std::endl;
+    std::cout << "  " << programName << " --range <video_path> <start_time_seconds> <end_time_seconds> <interval_seconds> <output_directory> [--jobs <n>]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --jobs <n>  : Face detection threads for --range (default: 1)" << std::endl;
     std::cout << "Examples:" << std::endl;
     std::cout << "  " << programName << " video.mp4 10.5 faces_output/" << std::endl;
     std::cout << "  " << programName << " --range video.mp4 5.0 15.0 1.0 faces_output/" << std::endl;
+    std::cout << "  " << programName << " --range video.mp4 0 3600 0.5 faces_output/ --jobs 8" << std::endl;
     std::cout << "Note: Ensure the output directory exists or can be created." << std::endl;
 }
 
@@ -226,31 +432,53 @@ int main(int argc, char* argv[]) {
     }
 
     try {
-        if (std::string(argv[1]) == "--range") {
-            if (argc != 7) {
+        // --jobs may appear anywhere; the remaining arguments are positional
+        std::vector<std::string> args;
+        int jobs = 1;
+        bool jobsGiven = false;
+        for (int i = 1; i < argc; i++) {
+            if (std::string(argv[i]) == "--jobs" && i + 1 < argc) {
+                jobs = std::stoi(argv[++i]);
+                jobsGiven = true;
+            } else {
+                args.push_back(argv[i]);
+            }
+        }
+        if (jobs < 1) {
+            std::cerr << "Error: --jobs must be at least 1." << std::endl;
+            return 1;
+        }
+
+        if (!args.empty() && args[0] == "--range") {
+            if (args.size() != 6) {
                 std::cerr << "Error: Incorrect number of arguments for --range mode." << std::endl;
                 printUsage(argv[0]);
                 return 1;
             }
-            std::string videoPath = argv[2];
-            float startTime = std::stof(argv[3]);
-            float endTime = std::stof(argv[4]);
-            float interval = std::stof(argv[5]);
-            std::string outputDir = argv[6];
+            std::string videoPath = args[1];
+            float startTime = std::stof(args[2]);
+            float endTime = std::stof(args[3]);
+            float interval = std::stof(args[4]);
+            std::string outputDir = args[5];
             
-            if (!extractor.extractFacesFromRange(videoPath, startTime, endTime, interval, outputDir)) {
+            if (!extractor.extractFacesFromRange(videoPath, startTime, endTime, interval, outputDir, jobs)) {
                 std::cerr << "Face extraction from range encountered errors." << std::endl;
                 return 1;
             }
         } else {
-            if (argc != 4) {
+            if (jobsGiven) {
+                std::cerr << "Error: --jobs is only supported in --range mode." << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+            if (args.size() != 3) {
                 std::cerr << "Error: Incorrect number of arguments for single timestamp mode." << std::endl;
                 printUsage(argv[0]);
                 return 1;
             }
-            std::string videoPath = argv[1];
-            float timestamp = std::stof(argv[2]);
-            std::string outputDir = argv[3];
+            std::string videoPath = args[0];
+            float timestamp = std::stof(args[1]);
+            std::string outputDir = args[2];
             
             if (!extractor.extractFaces(videoPath, timestamp, outputDir)) {
                 std::cerr << "Face extraction at timestamp failed." << std::endl;
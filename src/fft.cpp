@@ -0,0 +1,199 @@
+#include "fft.h"
+#include "dsp_target.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+const double PI = 3.14159265358979323846;
+
+FftPlan::FftPlan(int size) : m_size(size) {
+    if (size <= 0 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("FFT size must be a positive power of 2");
+    }
+
+    int log2n = 0;
+    while ((1 << log2n) < size) {
+        log2n++;
+    }
+
+    auto buildBitReverse = [](int n, int bits) {
+        std::vector<int> table(n);
+        for (int i = 0; i < n; i++) {
+            int j = 0;
+            for (int k = 0; k < bits; k++) {
+                j = (j << 1) | ((i >> k) & 1);
+            }
+            table[i] = j;
+        }
+        return table;
+    };
+    m_bitReverse = buildBitReverse(size, log2n);
+    if (size >= 2) {
+        m_halfBitReverse = buildBitReverse(size / 2, log2n - 1);
+    }
+
+    // Each twiddle is evaluated directly in double precision instead of by
+    // repeated multiplication, so there is no accumulated drift.
+    m_twiddles.resize(size / 2);
+    for (int k = 0; k < size / 2; k++) {
+        double angle = -2.0 * PI * k / size;
+        m_twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+}
+
+int FftPlan::size() const {
+    return m_size;
+}
+
+void FftPlan::forward(std::complex<float>* data) const {
+    transform(data, m_size, m_bitReverse, false);
+}
+
+void FftPlan::inverse(std::complex<float>* data) const {
+    transform(data, m_size, m_bitReverse, true);
+
+    const float scale = 1.0f / m_size;
+    for (int i = 0; i < m_size; i++) {
+        data[i] *= scale;
+    }
+}
+
+// The real-input pre- and post-processing passes are split out of the member
+// functions so they can be multiversioned without cloning the public methods.
+
+/**
+ * Turns the half-size transform of the even/odd packed input into the first
+ * half + 1 bins of the real spectrum, in place
+ * @param output Half-size transform on input, bins 0..half on output
+ * @param half Half the real transform size
+ * @param twiddles Twiddle table of the full-size plan
+ */
+DSP_TARGET_CLONES
+static void untangleRealSpectrum(std::complex<float>* output, int half, const std::complex<float>* twiddles) {
+    const float z0r = output[0].real();
+    const float z0i = output[0].imag();
+    output[0] = std::complex<float>(z0r + z0i, 0.0f);
+    output[half] = std::complex<float>(z0r - z0i, 0.0f);
+
+    // Bins k and half - k are built from the same pair, so both are
+    // computed together and written back in place.
+    for (int k = 1; k <= half / 2; k++) {
+        const int m = half - k;
+        const std::complex<float> zk = output[k];
+        const std::complex<float> zm = output[m];
+
+        // even = (zk + conj(zm)) / 2, odd = (zk - conj(zm)) / 2i
+        const float er = 0.5f * (zk.real() + zm.real());
+        const float ei = 0.5f * (zk.imag() - zm.imag());
+        const float orr = 0.5f * (zk.imag() + zm.imag());
+        const float oi = -0.5f * (zk.real() - zm.real());
+
+        // X[k] = even + W^k odd
+        const float wr = twiddles[k].real();
+        const float wi = twiddles[k].imag();
+        const float tr = wr * orr - wi * oi;
+        const float ti = wr * oi + wi * orr;
+        output[k] = std::complex<float>(er + tr, ei + ti);
+
+        // X[m] = conj(even) + W^m conj(odd)
+        const float vr = twiddles[m].real();
+        const float vi = twiddles[m].imag();
+        const float ur = vr * orr + vi * oi;
+        const float ui = vi * orr - vr * oi;
+        output[m] = std::complex<float>(er + ur, -ei + ui);
+    }
+}
+
+/**
+ * Packs bins 0..half of a real spectrum into the half-size spectrum whose
+ * inverse holds the even samples as real and the odd samples as imaginary parts
+ * @param input Bins 0..half
+ * @param packed Receives half bins
+ * @param half Half the real transform size
+ * @param twiddles Twiddle table of the full-size plan
+ */
+DSP_TARGET_CLONES
+static void packRealSpectrum(const std::complex<float>* input, std::complex<float>* packed, int half,
+                             const std::complex<float>* twiddles) {
+    for (int k = 0; k < half; k++) {
+        const std::complex<float> xk = input[k];
+        const std::complex<float> xm = input[half - k];
+
+        // even = (xk + conj(xm)) / 2, odd = (xk - conj(xm)) * conj(W^k) / 2
+        const float er = 0.5f * (xk.real() + xm.real());
+        const float ei = 0.5f * (xk.imag() - xm.imag());
+        const float dr = 0.5f * (xk.real() - xm.real());
+        const float di = 0.5f * (xk.imag() + xm.imag());
+        const float wr = twiddles[k].real();
+        const float wi = -twiddles[k].imag();
+        const float orr = dr * wr - di * wi;
+        const float oi = dr * wi + di * wr;
+
+        // packed = even + i * odd
+        packed[k] = std::complex<float>(er - oi, ei + orr);
+    }
+}
+
+void FftPlan::forwardReal(const float* input, std::complex<float>* output) const {
+    const int half = m_size / 2;
+
+    // Pack even samples as real and odd samples as imaginary parts, then
+    // transform at half size and untangle the two spectra.
+    for (int n = 0; n < half; n++) {
+        output[n] = std::complex<float>(input[2 * n], input[2 * n + 1]);
+    }
+    transform(output, half, m_halfBitReverse, false);
+    untangleRealSpectrum(output, half, m_twiddles.data());
+}
+
+void FftPlan::inverseReal(const std::complex<float>* input, float* output) const {
+    const int half = m_size / 2;
+
+    // The packed half-size spectrum fits exactly in the output buffer;
+    // std::complex<float> is layout-compatible with float[2].
+    std::complex<float>* packed = reinterpret_cast<std::complex<float>*>(output);
+    packRealSpectrum(input, packed, half, m_twiddles.data());
+
+    transform(packed, half, m_halfBitReverse, true);
+
+    const float scale = 1.0f / half;
+    for (int i = 0; i < m_size; i++) {
+        output[i] *= scale;
+    }
+}
+
+DSP_TARGET_CLONES
+void FftPlan::transform(std::complex<float>* data, int n, const std::vector<int>& bitReverse, bool inverse) const {
+    for (int i = 0; i < n; i++) {
+        int j = bitReverse[i];
+        if (j < i) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    // Twiddles are indexed against the full plan size, so the same table
+    // serves the half-size transforms used for real input.
+    for (int m = 2; m <= n; m <<= 1) {
+        const int m2 = m >> 1;
+        const int stride = m_size / m;
+        for (int k = 0; k < n; k += m) {
+            for (int j = 0; j < m2; j++) {
+                const std::complex<float>& w = m_twiddles[j * stride];
+                const float wr = w.real();
+                const float wi = inverse ? -w.imag() : w.imag();
+
+                // Written out by hand: std::complex multiplication goes
+                // through a NaN-checking library call without -ffast-math.
+                std::complex<float>& a = data[k + j];
+                std::complex<float>& b = data[k + j + m2];
+                const float tr = wr * b.real() - wi * b.imag();
+                const float ti = wr * b.imag() + wi * b.real();
+                const float ur = a.real();
+                const float ui = a.imag();
+                a = std::complex<float>(ur + tr, ui + ti);
+                b = std::complex<float>(ur - tr, ui - ti);
+            }
+        }
+    }
+}
@@ -1,4 +1,6 @@
 #include "filters.h"
+#include "dsp_target.h"
+#include "thread_pool.h"
 
 #include <cmath>
 #include <stdexcept>
@@ -8,8 +10,17 @@
 
 const double PI = 3.14159265358979323846;
 
-BandPassFilter::BandPassFilter(int sampleRate, float lowCutoff, float highCutoff)
-    : m_sampleRate(sampleRate), m_lowCutoff(lowCutoff), m_highCutoff(highCutoff) {
+// Below this many frames per slice the recomputed boundary frames and the
+// thread handoff cost more than the slice saves
+constexpr size_t kMinFramesPerSlice = 32;
+
+// Streaming spectral subtraction holds back at most this many samples
+// (about 0.7 s at 48 kHz) while waiting for enough frames to slice, so its
+// latency and buffer size do not grow with the core count
+constexpr size_t kMaxHoldbackSamples = 32768;
+
+BandPassFilter::BandPassFilter(int sampleRate, float lowCutoff, float highCutoff, int filterOrder)
+    : m_sampleRate(sampleRate), m_lowCutoff(lowCutoff), m_highCutoff(highCutoff), m_filterOrder(filterOrder) {
 
     if (sampleRate <= 0) {
         throw std::invalid_argument("Sample rate must be positive");
@@ -23,11 +34,16 @@ BandPassFilter::BandPassFilter(int sampleRate, float lowCutoff, float highCutoff
         throw std::invalid_argument("High cutoff must be less than Nyquist frequency");
     }
 
+    if (filterOrder <= 0 || filterOrder % 2 != 0) {
+        throw std::invalid_argument("Filter order must be a positive even number");
+    }
+
     calculateCoefficients();
+    m_engine = createConvolutionEngine(m_coefficients);
 }
 
 void BandPassFilter::calculateCoefficients() {
-    int filterOrder = 64;
+    int filterOrder = m_filterOrder;
     m_coefficients.resize(filterOrder + 1);
 
     float normalizedLow = 2.0f * m_lowCutoff / m_sampleRate;
@@ -62,30 +78,28 @@ void BandPassFilter::calculateCoefficients() {
 }
 
 std::vector<float> BandPassFilter::apply(const std::vector<float>& input) {
-    const int filterLength = static_cast<int>(m_coefficients.size());
-    const int inputLength = static_cast<int>(input.size());
-    std::vector<float> output(inputLength);
-
-    for (int i = 0; i < inputLength; i++) {
-        float sum = 0.0f;
-        for (int j = 0; j < filterLength; j++) {
-            int inputIdx = i - j;
-
-            if (inputIdx >= 0 && inputIdx < inputLength) {
-                sum += input[inputIdx] * m_coefficients[j];
-            }
-        }
-        output[i] = sum;
-    }
-
+    // A fresh engine keeps batch calls independent of any stream in progress
+    std::vector<float> output(input.size());
+    auto engine = createConvolutionEngine(m_coefficients);
+    engine->process(input.data(), output.data(), input.size());
     return output;
 }
 
-SpectralSubtraction::SpectralSubtraction(int sampleRate, int fftSize, int hopSize, float reductionFactor)
-    : m_sampleRate(sampleRate), m_fftSize(fftSize), m_hopSize(hopSize), m_reductionFactor(reductionFactor) {
+void BandPassFilter::process(const float* input, float* output, size_t count) {
+    m_engine->process(input, output, count);
+}
+
+void BandPassFilter::reset() {
+    m_engine->reset();
+}
+
+SpectralSubtraction::SpectralSubtraction(int sampleRate, int fftSize, int hopSize, float reductionFactor,
+                                         int numThreads)
+    : m_sampleRate(sampleRate), m_fftSize(fftSize), m_hopSize(hopSize), m_reductionFactor(reductionFactor),
+      m_fftPlan(fftSize) {
 
-    if (fftSize <= 0 || (fftSize & (fftSize - 1)) != 0) {
-        throw std::invalid_argument("FFT size must be a positive power of 2");
+    if (fftSize < 2 || (fftSize & (fftSize - 1)) != 0) {
+        throw std::invalid_argument("FFT size must be a power of 2 and at least 2");
     }
 
     if (hopSize <= 0 || hopSize > fftSize) {
@@ -95,8 +109,19 @@ SpectralSubtraction::SpectralSubtraction(int sampleRate, int fftSize, int hopSiz
     if (reductionFactor < 0.0f || reductionFactor > 1.0f) {
         throw std::invalid_argument("Reduction factor must be between 0 and 1");
     }
+
+    m_window = getWindowFunction(fftSize);
+    m_workspace.samples.resize(fftSize);
+    m_workspace.spectrum.resize(fftSize / 2 + 1);
+
+    if (numThreads > 1) {
+        m_pool = std::make_unique<ThreadPool>(numThreads);
+        m_sliceWorkspaces.assign(numThreads, m_workspace);
+    }
 }
 
+SpectralSubtraction::~SpectralSubtraction() = default;
+
 std::vector<float> SpectralSubtraction::getWindowFunction(int size) {
     std::vector<float> window(size);
     for (int i = 0; i < size; i++) {
@@ -105,79 +130,17 @@ std::vector<float> SpectralSubtraction::getWindowFunction(int size) {
     return window;
 }
 
-void SpectralSubtraction::fft_complex_inplace(std::vector<std::complex<float>>& buffer) {
-    int n = buffer.size();
-    if (n == 0 || (n & (n - 1)) != 0) {
-        throw std::runtime_error("FFT size must be a power of 2 for fft_complex_inplace");
-    }
-    int log2n = 0;
-    while ((1 << log2n) < n) {
-        log2n++;
+void SpectralSubtraction::performFFT(const float* input, FrameWorkspace& workspace) const {
+    for (int i = 0; i < m_fftSize; i++) {
+        workspace.samples[i] = input[i] * m_window[i];
     }
 
-    for (int i = 0; i < n; i++) {
-        int j = 0;
-        for (int k = 0; k < log2n; k++) {
-            j = (j << 1) | ((i >> k) & 1);
-        }
-        if (j < i) {
-            std::swap(buffer[i], buffer[j]);
-        }
-    }
-
-    for (int s = 1; s <= log2n; s++) {
-        int m = 1 << s;
-        int m2 = m >> 1;
-        std::complex<float> w(1, 0);
-        std::complex<float> wm(cos(-2 * PI / m), sin(-2 * PI / m));
-
-        for (int j = 0; j < m2; j++) {
-            for (int k = j; k < n; k += m) {
-                std::complex<float> t = w * buffer[k + m2];
-                std::complex<float> u = buffer[k];
-                buffer[k] = u + t;
-                buffer[k + m2] = u - t;
-            }
-            w *= wm;
-        }
-    }
+    // Only the non-negative bins are kept; the rest mirror them for real input
+    m_fftPlan.forwardReal(workspace.samples.data(), workspace.spectrum.data());
 }
 
-std::vector<std::complex<float>> SpectralSubtraction::performFFT(const std::vector<float>& input, int start, int size) {
-    std::vector<std::complex<float>> buffer(size);
-
-    auto window = getWindowFunction(size);
-    for (int i = 0; i < size; i++) {
-        int inputIdx = start + i;
-        if (inputIdx < static_cast<int>(input.size())) {
-            buffer[i] = std::complex<float>(input[inputIdx] * window[i], 0);
-        } else {
-            buffer[i] = std::complex<float>(0, 0);
-        }
-    }
-
-    fft_complex_inplace(buffer);
-
-    return buffer;
-}
-
-std::vector<float> SpectralSubtraction::performIFFT(const std::vector<std::complex<float>>& spectrum) {
-    int size = static_cast<int>(spectrum.size());
-    if (size == 0) return {};
-
-    std::vector<std::complex<float>> buffer = spectrum;
-    for (auto& val : buffer) {
-        val = std::conj(val);
-    }
-
-    fft_complex_inplace(buffer);
-
-    std::vector<float> result(size);
-    for (int i = 0; i < size; i++) {
-        result[i] = std::conj(buffer[i]).real() / size;
-    }
-
-    return result;
+void SpectralSubtraction::performIFFT(FrameWorkspace& workspace) const {
+    m_fftPlan.inverseReal(workspace.spectrum.data(), workspace.samples.data());
 }
 
 std::vector<float> SpectralSubtraction::estimateNoiseProfile(const std::vector<float>& input, float durationSec) {
@@ -188,11 +151,10 @@ std::vector<float> SpectralSubtraction::estimateNoiseProfile(const std::vector<f
     int numFrames = 0;
 
     for (int start = 0; start < samplesForEstimation - m_fftSize; start += m_hopSize) {
-        auto spectrum = performFFT(input, start, m_fftSize);
+        performFFT(input.data() + start, m_workspace);
 
         for (int i = 0; i <= m_fftSize / 2; i++) {
-            float magnitude = std::abs(spectrum[i]);
-            noiseProfile[i] += magnitude * magnitude;
+            noiseProfile[i] += std::norm(m_workspace.spectrum[i]);
         }
 
         numFrames++;
@@ -207,6 +169,74 @@ std::vector<float> SpectralSubtraction::estimateNoiseProfile(const std::vector<f
     return noiseProfile;
 }
 
+DSP_TARGET_CLONES
+void SpectralSubtraction::processFrame(const float* input, const std::vector<float>& noise,
+                                       FrameWorkspace& workspace, float* output, size_t begin, size_t end) const {
+    performFFT(input, workspace);
+
+    // Scaling each bin by sqrt(resultPower / power) keeps its phase, which
+    // avoids the atan2/sincos round trip through polar form.
+    for (int i = 0; i <= m_fftSize / 2; i++) {
+        std::complex<float>& bin = workspace.spectrum[i];
+        float power = bin.real() * bin.real() + bin.imag() * bin.imag();
+        float noisePower = noise[i] * m_reductionFactor;
+        float resultPower = std::max(power - noisePower, 0.01f * power);
+        float gain = (power > 0.0f) ? std::sqrt(resultPower / power) : 0.0f;
+        bin = std::complex<float>(bin.real() * gain, bin.imag() * gain);
+    }
+
+    performIFFT(workspace);
+
+    // Only [begin, end) of the frame is added, for slices that own part of it
+    for (size_t i = begin; i < end; i++) {
+        output[i] += workspace.samples[i] * m_window[i];
+    }
+}
+
+void SpectralSubtraction::overlapAddFrames(const float* input, size_t numFrames, const std::vector<float>& noise,
+                                           float* output) {
+    const size_t fftSize = static_cast<size_t>(m_fftSize);
+    const size_t hopSize = static_cast<size_t>(m_hopSize);
+
+    size_t slices = 1;
+    if (m_pool) {
+        slices = std::min(static_cast<size_t>(m_pool->size()), numFrames / kMinFramesPerSlice);
+    }
+
+    if (slices <= 1) {
+        for (size_t frame = 0; frame < numFrames; frame++) {
+            size_t start = frame * hopSize;
+            processFrame(input + start, noise, m_workspace, output + start, 0, fftSize);
+        }
+        return;
+    }
+
+    // Each slice owns a hop-aligned range of output samples and recomputes
+    // every frame overlapping it, adding only inside its own range. Every
+    // sample thus gets the same contributions in the same frame order as in
+    // the sequential loop, so the stitched result is bit-identical.
+    const size_t framesPerSlice = (numFrames + slices - 1) / slices;
+    const size_t outputSize = (numFrames - 1) * hopSize + fftSize;
+
+    m_pool->parallelFor(slices, [&](size_t slice) {
+        size_t sliceBegin = slice * framesPerSlice * hopSize;
+        size_t sliceEnd = (slice + 1 == slices) ? outputSize
+                                                : std::min(outputSize, (slice + 1) * framesPerSlice * hopSize);
+        if (sliceBegin >= sliceEnd) {
+            return;
+        }
+
+        size_t firstFrame = (sliceBegin + hopSize > fftSize) ? (sliceBegin + hopSize - fftSize) / hopSize : 0;
+        size_t endFrame = std::min(numFrames, (sliceEnd + hopSize - 1) / hopSize);
+        for (size_t frame = firstFrame; frame < endFrame; frame++) {
+            size_t start = frame * hopSize;
+            size_t begin = std::max(sliceBegin, start) - start;
+            size_t end = std::min(sliceEnd, start + fftSize) - start;
+            processFrame(input + start, noise, m_sliceWorkspaces[slice], output + start, begin, end);
+        }
+    });
+}
+
 std::vector<float> SpectralSubtraction::process(const std::vector<float>& input, const std::vector<float>* noiseProfile) {
     std::vector<float> noise;
     if (noiseProfile == nullptr) {
@@ -221,55 +251,128 @@ std::vector<float> SpectralSubtraction::process(const std::vector<float>& input,
     }
 
     std::vector<float> output(input.size(), 0.0f);
-    auto window = getWindowFunction(m_fftSize);
 
-    for (size_t start = 0; start + m_fftSize <= input.size(); start += m_hopSize) {
-        auto spectrum = performFFT(input, static_cast<int>(start), m_fftSize);
+    if (input.size() >= static_cast<size_t>(m_fftSize)) {
+        size_t numFrames = (input.size() - m_fftSize) / m_hopSize + 1;
+        overlapAddFrames(input.data(), numFrames, noise, output.data());
+    }
 
-        for (int i = 0; i <= m_fftSize / 2; i++) {
-            float magnitude = std::abs(spectrum[i]);
-            float phase = std::arg(spectrum[i]);
+    for (size_t i = 0; i < output.size(); i++) {
+        output[i] /= 1.5f;
+    }
 
-            float power = magnitude * magnitude;
-            float noisePower = noise[i] * m_reductionFactor;
-            float resultPower = std::max(power - noisePower, 0.01f * power);
-            float resultMagnitude = std::sqrt(resultPower);
+    return output;
+}
 
-            spectrum[i] = std::polar(resultMagnitude, phase);
+void SpectralSubtraction::pushBlock(const float* input, size_t count, std::vector<float>& output) {
+    m_pending.insert(m_pending.end(), input, input + count);
 
-            if (i > 0 && i < m_fftSize / 2) {
-                spectrum[m_fftSize - i] = std::conj(spectrum[i]);
-            }
+    if (!m_hasStreamNoise) {
+        // Same estimation window as the batch path
+        size_t estimationSamples = static_cast<size_t>(m_sampleRate * 0.5f);
+        if (m_pending.size() < estimationSamples) {
+            return;
         }
+        m_streamNoise = estimateNoiseProfile(m_pending);
+        m_hasStreamNoise = true;
+    }
+
+    processPendingFrames(output, false);
+}
+
+void SpectralSubtraction::flush(std::vector<float>& output) {
+    if (!m_hasStreamNoise) {
+        m_streamNoise = estimateNoiseProfile(m_pending);
+        m_hasStreamNoise = true;
+    }
+    processPendingFrames(output, true);
+
+    // Samples after the last full frame only carry partial overlap-add sums
+    for (size_t i = 0; i < m_pending.size(); i++) {
+        float value = (i < m_overlap.size()) ? m_overlap[i] : 0.0f;
+        output.push_back(value / 1.5f);
+    }
 
-        auto frame = performIFFT(spectrum);
+    reset();
+}
+
+void SpectralSubtraction::reset() {
+    m_pending.clear();
+    m_overlap.clear();
+    m_streamNoise.clear();
+    m_hasStreamNoise = false;
+}
 
-        for (int i = 0; i < m_fftSize; i++) {
-            if (start + i < output.size()) {
-                output[start + i] += frame[i] * window[i];
-            }
+void SpectralSubtraction::processPendingFrames(std::vector<float>& output, bool finalBlock) {
+    const size_t fftSize = static_cast<size_t>(m_fftSize);
+    const size_t hopSize = static_cast<size_t>(m_hopSize);
+    if (m_pending.size() < fftSize) {
+        return;
+    }
+
+    // m_overlap holds the unfinished tails of earlier frames, aligned with m_pending
+    size_t numFrames = (m_pending.size() - fftSize) / hopSize + 1;
+
+    // With a pool, frames are held back until there are enough to fill every
+    // slice or the holdback cap is reached; overlapAddFrames cuts fewer slices
+    // from a short batch
+    if (m_pool && !finalBlock) {
+        size_t holdbackFrames = std::max<size_t>(1, kMaxHoldbackSamples / hopSize);
+        if (numFrames < std::min(kMinFramesPerSlice * m_pool->size(), holdbackFrames)) {
+            return;
         }
     }
 
-    for (size_t i = 0; i < output.size(); i++) {
-        output[i] /= 1.5f;
+    m_overlap.resize((numFrames - 1) * hopSize + fftSize, 0.0f);
+    overlapAddFrames(m_pending.data(), numFrames, m_streamNoise, m_overlap.data());
+
+    // No later frame touches the first numFrames * hopSize samples
+    size_t finished = numFrames * hopSize;
+    for (size_t i = 0; i < finished; i++) {
+        output.push_back(m_overlap[i] / 1.5f);
     }
 
-    return output;
+    m_overlap.erase(m_overlap.begin(), m_overlap.begin() + finished);
+    m_pending.erase(m_pending.begin(), m_pending.begin() + finished);
 }
 
-AudioProcessor::AudioProcessor(int sampleRate, float lowCutoff, float highCutoff, float noiseReduction)
+AudioProcessor::AudioProcessor(int sampleRate, float lowCutoff, float highCutoff, float noiseReduction,
+                               int numThreads)
     : m_sampleRate(sampleRate) {
 
     m_bandPassFilter = std::make_unique<BandPassFilter>(sampleRate, lowCutoff, highCutoff);
 
     int fftSize = 2048;
     int hopSize = fftSize / 4;
-    m_spectralSubtraction = std::make_unique<SpectralSubtraction>(sampleRate, fftSize, hopSize, noiseReduction);
+    m_spectralSubtraction = std::make_unique<SpectralSubtraction>(sampleRate, fftSize, hopSize, noiseReduction,
+                                                                  numThreads);
 }
 
 std::vector<float> AudioProcessor::process(const std::vector<float>& input) {
     auto filtered = m_bandPassFilter->apply(input);
     auto result = m_spectralSubtraction->process(filtered);
     return result;
-}
\ No newline at end of file
+}
+
+void AudioProcessor::pushBlock(const float* input, size_t count, std::vector<float>& output) {
+    m_filteredBlock.resize(count);
+    {
+        StageTimer timer(&m_bandPassTime, count);
+        m_bandPassFilter->process(input, m_filteredBlock.data(), count);
+    }
+    StageTimer timer(&m_spectralSubtractionTime, count);
+    m_spectralSubtraction->pushBlock(m_filteredBlock.data(), count, output);
+}
+
+void AudioProcessor::flush(std::vector<float>& output) {
+    {
+        StageTimer timer(&m_spectralSubtractionTime);
+        m_spectralSubtraction->flush(output);
+    }
+    m_bandPassFilter->reset();
+}
+
+void AudioProcessor::collectStageTimes(PipelineStats& stats) const {
+    stats.add(PipelineStage::BandPass, m_bandPassTime);
+    stats.add(PipelineStage::SpectralSubtraction, m_spectralSubtractionTime);
+}
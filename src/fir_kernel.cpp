@@ -0,0 +1,117 @@
+#include "fir_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VIDEO_CLEANER_X86 1
+#endif
+
+void firFilterScalar(const float* samples, const float* reversedTaps, size_t numTaps, float* output, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const float* x = samples + i;
+        float sum = 0.0f;
+        for (size_t k = 0; k < numTaps; k++) {
+            sum += x[k] * reversedTaps[k];
+        }
+        output[i] = sum;
+    }
+}
+
+#ifdef VIDEO_CLEANER_X86
+
+// Both SIMD kernels vectorise across outputs: each coefficient is broadcast
+// once and multiplied into several neighbouring outputs, so no horizontal
+// sums are needed and every load is a unit-stride walk through samples.
+// They add the products in the same order as the scalar loop and round the
+// multiply and the add separately (no FMA), so every variant gives
+// bit-identical output.
+
+__attribute__((target("avx2")))
+static void firFilterAvx2(const float* samples, const float* reversedTaps, size_t numTaps, float* output, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const float* x = samples + i;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        for (size_t k = 0; k < numTaps; k++) {
+            __m256 c = _mm256_broadcast_ss(reversedTaps + k);
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(c, _mm256_loadu_ps(x + k)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(c, _mm256_loadu_ps(x + k + 8)));
+            acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(c, _mm256_loadu_ps(x + k + 16)));
+            acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(c, _mm256_loadu_ps(x + k + 24)));
+        }
+        _mm256_storeu_ps(output + i, acc0);
+        _mm256_storeu_ps(output + i + 8, acc1);
+        _mm256_storeu_ps(output + i + 16, acc2);
+        _mm256_storeu_ps(output + i + 24, acc3);
+    }
+    for (; i + 8 <= count; i += 8) {
+        const float* x = samples + i;
+        __m256 acc = _mm256_setzero_ps();
+        for (size_t k = 0; k < numTaps; k++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_broadcast_ss(reversedTaps + k), _mm256_loadu_ps(x + k)));
+        }
+        _mm256_storeu_ps(output + i, acc);
+    }
+    firFilterScalar(samples + i, reversedTaps, numTaps, output + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void firFilterSse(const float* samples, const float* reversedTaps, size_t numTaps, float* output, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const float* x = samples + i;
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        for (size_t k = 0; k < numTaps; k++) {
+            __m128 c = _mm_set1_ps(reversedTaps[k]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(c, _mm_loadu_ps(x + k)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(c, _mm_loadu_ps(x + k + 4)));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(c, _mm_loadu_ps(x + k + 8)));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(c, _mm_loadu_ps(x + k + 12)));
+        }
+        _mm_storeu_ps(output + i, acc0);
+        _mm_storeu_ps(output + i + 4, acc1);
+        _mm_storeu_ps(output + i + 8, acc2);
+        _mm_storeu_ps(output + i + 12, acc3);
+    }
+    firFilterScalar(samples + i, reversedTaps, numTaps, output + i, count - i);
+}
+
+#endif
+
+using FirKernel = void (*)(const float*, const float*, size_t, float*, size_t);
+
+struct FirKernelChoice {
+    FirKernel kernel;
+    const char* name;
+};
+
+static FirKernelChoice selectFirKernel() {
+#ifdef VIDEO_CLEANER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {firFilterAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {firFilterSse, "sse"};
+    }
+#endif
+    return {firFilterScalar, "scalar"};
+}
+
+static const FirKernelChoice& firKernelChoice() {
+    static const FirKernelChoice choice = selectFirKernel();
+    return choice;
+}
+
+void firFilter(const float* samples, const float* reversedTaps, size_t numTaps, float* output, size_t count) {
+    firKernelChoice().kernel(samples, reversedTaps, numTaps, output, count);
+}
+
+const char* firKernelName() {
+    return firKernelChoice().name;
+}
@@ -0,0 +1,45 @@
+#include "frame_pool.h"
+
+#include <utility>
+
+FramePool::FramePool(size_t capacity) : m_capacity(capacity) {
+    m_idle.reserve(capacity);
+}
+
+cv::Mat FramePool::acquire(int rows, int cols, int type) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_idle.size(); i++) {
+            const cv::Mat& candidate = m_idle[i];
+            if (candidate.rows == rows && candidate.cols == cols && candidate.type() == type) {
+                cv::Mat frame = std::move(m_idle[i]);
+                m_idle[i] = std::move(m_idle.back());
+                m_idle.pop_back();
+                return frame;
+            }
+        }
+
+        // Nothing fits, so the stream changed size; stale buffers would only hold memory
+        m_idle.clear();
+        m_allocations++;
+    }
+    return cv::Mat(rows, cols, type);
+}
+
+void FramePool::recycle(cv::Mat& frame) {
+    // Only a sole owner may hand the buffer on, or a later acquire() would
+    // overwrite pixels someone else is still reading
+    bool reusable = !frame.empty() && frame.u && frame.u->refcount == 1 && !frame.isSubmatrix();
+    if (reusable) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_idle.size() < m_capacity) {
+            m_idle.push_back(std::move(frame));
+        }
+    }
+    frame.release();
+}
+
+size_t FramePool::allocations() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocations;
+}
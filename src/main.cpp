@@ -1,10 +1,12 @@
 #include "main.h"
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <memory>
 #include <cstring>
 
+#include "media_muxer.h"
 #include "process.h"
 #include "video_denoise.h"
 
@@ -16,6 +18,23 @@ void printUsage(const char* programName) {
     std::cout << "  --high-cutoff <Hz>          : High cutoff frequency for bandpass filter (default: 8000)" << std::endl;
     std::cout << "  --noise-reduction <0-1>     : Spectral subtraction noise reduction factor (default: 0.5)" << std::endl;
     std::cout << "  --video-denoise-strength <0-100> : Video denoising strength (default: 10)" << std::endl;
+    std::cout << "  --threads <N>               : Number of parallel video denoise workers (default: 1)" << std::endl;
+    std::cout << "  --denoiser <spatial|temporal> : Video denoising backend (default: spatial)" << std::endl;
+    std::cout << "  --temporal-window <2-16>    : Frames averaged by the temporal denoiser (default: 5)" << std::endl;
+    std::cout << "  --tile-size <px>            : Run NLM on tiles of this size in parallel, 0 = whole frames (default: 0)" << std::endl;
+    std::cout << "  --yuv                       : Keep frames in planar YUV 4:2:0 and denoise each plane on its own" << std::endl;
+    std::cout << "  --preview, --fast           : Denoise a downscaled luma plane for quick proxy/preview renders" << std::endl;
+    std::cout << "  --preview-scale <2-4>       : Downscale factor for --preview (default: 2)" << std::endl;
+    std::cout << "  --skip-threshold <0-255>    : Reuse output for tiles whose mean change is at most this, off by default" << std::endl;
+    std::cout << "  --contrast <gain>           : Contrast gain applied to denoised frames, 1 = unchanged (default: 1.2)" << std::endl;
+    std::cout << "  --brightness <offset>       : Brightness offset applied to denoised frames, 0 = unchanged (default: 5)" << std::endl;
+    std::cout << "  --codec <name>              : Video encoder or codec name, e.g. libx264, libx265, hevc (default: libx264)" << std::endl;
+    std::cout << "  --preset <name>             : Encoder speed preset, e.g. ultrafast..veryslow (default: encoder default)" << std::endl;
+    std::cout << "  --crf <0-63>                : Constant rate factor, lower = larger and better (default: encoder default)" << std::endl;
+    std::cout << "  --bitrate <kbit/s>          : Target video bitrate instead of CRF (default: CRF)" << std::endl;
+    std::cout << "  --encoder-threads <N>       : Video encoder threads, 0 = one per core (default: FFmpeg's 1)" << std::endl;
+    std::cout << "  --gop <frames>              : Maximum frames between keyframes, 0 = encoder default (default: 0)" << std::endl;
+    std::cout << "  --stats-json <path>         : Write per-stage wall/CPU times and throughput as JSON" << std::endl;
     std::cout << "  --help, -h                  : Display this help message" << std::endl;
 }
 
@@ -24,6 +43,11 @@ int main(int argc, char* argv[]) {
     float highCutoff = 8000.0f;
     float noiseReduction = 0.5f;
     float videoDenoiseStrength = 10.0f;
+    int numThreads = 1;
+    VideoDenoiserOptions denoiserOptions;
+    EncoderSettings encoderSettings;
+    std::string statsPath;
+    std::string denoiserName = "spatial";
     std::string inputPath;
     std::string outputPath;
 
@@ -41,6 +65,75 @@ int main(int argc, char* argv[]) {
         } else if (strcmp(argv[argIdx], "--video-denoise-strength") == 0 && argIdx + 1 < argc) {
             videoDenoiseStrength = std::stof(argv[argIdx + 1]);
             argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--threads") == 0 && argIdx + 1 < argc) {
+            numThreads = std::stoi(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--denoiser") == 0 && argIdx + 1 < argc) {
+            denoiserName = argv[argIdx + 1];
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--temporal-window") == 0 && argIdx + 1 < argc) {
+            denoiserOptions.temporalWindow = std::stoi(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--tile-size") == 0 && argIdx + 1 < argc) {
+            denoiserOptions.tileSize = std::stoi(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--yuv") == 0) {
+            denoiserOptions.planarYuv = true;
+            argIdx++;
+        } else if (strcmp(argv[argIdx], "--preview") == 0 || strcmp(argv[argIdx], "--fast") == 0) {
+            denoiserOptions.preview = true;
+            argIdx++;
+        } else if (strcmp(argv[argIdx], "--preview-scale") == 0 && argIdx + 1 < argc) {
+            denoiserOptions.previewScale = std::stoi(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--skip-threshold") == 0 && argIdx + 1 < argc) {
+            denoiserOptions.skipThreshold = std::stod(argv[argIdx + 1]);
+            // Checked here because a negative value means off; "nan" fails every comparison
+            if (!std::isfinite(denoiserOptions.skipThreshold) ||
+                denoiserOptions.skipThreshold < 0 || denoiserOptions.skipThreshold > 255) {
+                std::cerr << "Error: Skip threshold must be between 0 and 255" << std::endl;
+                return 1;
+            }
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--contrast") == 0 && argIdx + 1 < argc) {
+            denoiserOptions.contrast = std::stod(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--brightness") == 0 && argIdx + 1 < argc) {
+            denoiserOptions.brightness = std::stod(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--codec") == 0 && argIdx + 1 < argc) {
+            encoderSettings.codec = argv[argIdx + 1];
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--preset") == 0 && argIdx + 1 < argc) {
+            encoderSettings.preset = argv[argIdx + 1];
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--crf") == 0 && argIdx + 1 < argc) {
+            encoderSettings.crf = std::stoi(argv[argIdx + 1]);
+            if (encoderSettings.crf < 0) {
+                std::cerr << "Error: CRF must be between 0 and 63" << std::endl;
+                return 1;
+            }
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--bitrate") == 0 && argIdx + 1 < argc) {
+            encoderSettings.bitrate = std::stoll(argv[argIdx + 1]) * 1000;
+            if (encoderSettings.bitrate <= 0) {
+                std::cerr << "Error: Bitrate must be positive" << std::endl;
+                return 1;
+            }
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--encoder-threads") == 0 && argIdx + 1 < argc) {
+            encoderSettings.threads = std::stoi(argv[argIdx + 1]);
+            if (encoderSettings.threads < 0) {
+                std::cerr << "Error: Encoder thread count must not be negative" << std::endl;
+                return 1;
+            }
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--gop") == 0 && argIdx + 1 < argc) {
+            encoderSettings.gopSize = std::stoi(argv[argIdx + 1]);
+            argIdx += 2;
+        } else if (strcmp(argv[argIdx], "--stats-json") == 0 && argIdx + 1 < argc) {
+            statsPath = argv[argIdx + 1];
+            argIdx += 2;
         } else if (strcmp(argv[argIdx], "--help") == 0 || strcmp(argv[argIdx], "-h") == 0) {
             printUsage(argv[0]);
             return 0;
@@ -76,14 +169,122 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (numThreads < 1) {
+        std::cerr << "Error: Thread count must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (denoiserName == "spatial") {
+        denoiserOptions.backend = DenoiserBackend::Spatial;
+    } else if (denoiserName == "temporal") {
+        denoiserOptions.backend = DenoiserBackend::Temporal;
+    } else {
+        std::cerr << "Error: Denoiser must be 'spatial' or 'temporal'" << std::endl;
+        return 1;
+    }
+
+    if (denoiserOptions.temporalWindow < 2 || denoiserOptions.temporalWindow > 16) {
+        std::cerr << "Error: Temporal window must be between 2 and 16 frames" << std::endl;
+        return 1;
+    }
+
+    if (denoiserOptions.tileSize != 0 && denoiserOptions.tileSize < 32) {
+        std::cerr << "Error: Tile size must be 0 (whole frames) or at least 32 pixels" << std::endl;
+        return 1;
+    }
+
+    if (denoiserOptions.previewScale < 2 || denoiserOptions.previewScale > 4) {
+        std::cerr << "Error: Preview scale must be between 2 and 4" << std::endl;
+        return 1;
+    }
+
+    if (denoiserOptions.planarYuv && denoiserOptions.preview) {
+        std::cerr << "Error: --yuv cannot be combined with --preview" << std::endl;
+        return 1;
+    }
+
+    if (denoiserOptions.skipThreshold >= 0 && denoiserOptions.backend == DenoiserBackend::Temporal) {
+        std::cerr << "Error: --skip-threshold needs the spatial denoiser" << std::endl;
+        return 1;
+    }
+
+    if (denoiserOptions.skipThreshold >= 0 && denoiserOptions.preview) {
+        std::cerr << "Error: --skip-threshold cannot be combined with --preview" << std::endl;
+        return 1;
+    }
+
+    // std::stod accepts "nan" and "inf", which no range check below would catch
+    if (!std::isfinite(denoiserOptions.contrast) || denoiserOptions.contrast < 0) {
+        std::cerr << "Error: Contrast must be a finite, non-negative number" << std::endl;
+        return 1;
+    }
+
+    if (!std::isfinite(denoiserOptions.brightness) ||
+        denoiserOptions.brightness < -255 || denoiserOptions.brightness > 255) {
+        std::cerr << "Error: Brightness must be between -255 and 255" << std::endl;
+        return 1;
+    }
+
+    if (encoderSettings.codec.empty()) {
+        std::cerr << "Error: Codec name must not be empty" << std::endl;
+        return 1;
+    }
+
+    if (encoderSettings.crf > 63) {
+        std::cerr << "Error: CRF must be between 0 and 63" << std::endl;
+        return 1;
+    }
+
+    if (encoderSettings.crf >= 0 && encoderSettings.bitrate > 0) {
+        std::cerr << "Error: --crf and --bitrate cannot be combined" << std::endl;
+        return 1;
+    }
+
+    if (encoderSettings.gopSize < 0) {
+        std::cerr << "Error: GOP size must not be negative" << std::endl;
+        return 1;
+    }
+
     try {
         std::cout << "Processing video with the following parameters:" << std::endl;
         std::cout << "  Low cutoff: " << lowCutoff << " Hz" << std::endl;
         std::cout << "  High cutoff: " << highCutoff << " Hz" << std::endl;
         std::cout << "  Noise reduction: " << noiseReduction << std::endl;
         std::cout << "  Video denoise strength: " << videoDenoiseStrength << std::endl;
+        std::cout << "  Video threads: " << numThreads << std::endl;
+        std::cout << "  Video denoiser: " << denoiserName;
+        if (denoiserOptions.backend == DenoiserBackend::Temporal) {
+            std::cout << " (" << denoiserOptions.temporalWindow << " frame window)";
+        } else if (denoiserOptions.tileSize > 0) {
+            std::cout << " (" << denoiserOptions.tileSize << " px tiles)";
+        }
+        if (denoiserOptions.preview) {
+            std::cout << ", preview at 1/" << denoiserOptions.previewScale << " size";
+        }
+        if (denoiserOptions.planarYuv) {
+            std::cout << ", planar YUV";
+        }
+        if (denoiserOptions.skipThreshold >= 0) {
+            std::cout << ", skipping tiles changed by at most " << denoiserOptions.skipThreshold;
+        }
+        std::cout << std::endl;
+        std::cout << "  Contrast: " << denoiserOptions.contrast << ", brightness: " << denoiserOptions.brightness
+                  << std::endl;
         
-        VideoProcessor processor(lowCutoff, highCutoff, noiseReduction, videoDenoiseStrength);
+        std::cout << "  Video encoder: " << encoderSettings.codec;
+        if (!encoderSettings.preset.empty()) {
+            std::cout << ", preset " << encoderSettings.preset;
+        }
+        if (encoderSettings.bitrate > 0) {
+            std::cout << ", " << encoderSettings.bitrate / 1000 << " kbit/s";
+        } else if (encoderSettings.crf >= 0) {
+            std::cout << ", CRF " << encoderSettings.crf;
+        }
+        std::cout << std::endl;
+
+        VideoProcessor processor(lowCutoff, highCutoff, noiseReduction, videoDenoiseStrength, numThreads,
+                                 denoiserOptions, encoderSettings);
+        processor.setStatsPath(statsPath);
         bool success = processor.processVideo(inputPath, outputPath);
         
         if (success) {
@@ -0,0 +1,333 @@
+#include "media_demuxer.h"
+#include "frame_pool.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/opt.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+#include <libswscale/swscale.h>
+}
+
+// Stream side data moved into AVCodecParameters in FFmpeg 6.1
+#define HAVE_CODECPAR_SIDE_DATA (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 31, 102))
+
+void AVPacketDeleter::operator()(AVPacket* packet) const {
+    av_packet_free(&packet);
+}
+
+MediaDemuxer::MediaDemuxer() {
+}
+
+MediaDemuxer::~MediaDemuxer() {
+    if (!m_audioBuffer.empty()) {
+        av_freep(&m_audioBuffer[0]);
+    }
+    swr_free(&m_swrContext);
+    av_frame_free(&m_audioFrame);
+    avcodec_free_context(&m_audioCodec);
+
+    sws_freeContext(m_swsContext);
+    av_frame_free(&m_videoFrame);
+    avcodec_free_context(&m_videoCodec);
+
+    if (m_formatContext) {
+        avformat_close_input(&m_formatContext);
+    }
+}
+
+bool MediaDemuxer::open(const std::string& inputPath) {
+    if (avformat_open_input(&m_formatContext, inputPath.c_str(), nullptr, nullptr) != 0) {
+        std::cerr << "Could not open input file: " << inputPath << std::endl;
+        return false;
+    }
+
+    if (avformat_find_stream_info(m_formatContext, nullptr) < 0) {
+        std::cerr << "Could not find stream information" << std::endl;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < m_formatContext->nb_streams; i++) {
+        AVMediaType type = m_formatContext->streams[i]->codecpar->codec_type;
+        if (type == AVMEDIA_TYPE_VIDEO && m_videoStreamIndex == -1) {
+            m_videoStreamIndex = i;
+        } else if (type == AVMEDIA_TYPE_AUDIO && m_audioStreamIndex == -1) {
+            m_audioStreamIndex = i;
+        }
+    }
+
+    if (m_videoStreamIndex == -1) {
+        std::cerr << "Could not find video stream in input file" << std::endl;
+        return false;
+    }
+
+    if (!openVideoDecoder()) {
+        return false;
+    }
+
+    // A missing or undecodable audio stream is reported through hasAudio()
+    if (m_audioStreamIndex != -1 && !openAudioDecoder()) {
+        avcodec_free_context(&m_audioCodec);
+    }
+    return true;
+}
+
+bool MediaDemuxer::openVideoDecoder() {
+    AVStream* stream = m_formatContext->streams[m_videoStreamIndex];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        std::cerr << "Unsupported video codec" << std::endl;
+        return false;
+    }
+
+    m_videoCodec = avcodec_alloc_context3(codec);
+    m_videoFrame = av_frame_alloc();
+    if (!m_videoCodec || !m_videoFrame) {
+        std::cerr << "Failed to allocate video decoder" << std::endl;
+        return false;
+    }
+
+    if (avcodec_parameters_to_context(m_videoCodec, stream->codecpar) < 0) {
+        std::cerr << "Failed to copy video codec parameters to context" << std::endl;
+        return false;
+    }
+
+    // Let the decoder pick its own thread count; decoding runs on the reader thread
+    m_videoCodec->thread_count = 0;
+    if (avcodec_open2(m_videoCodec, codec, nullptr) < 0) {
+        std::cerr << "Failed to open video codec" << std::endl;
+        return false;
+    }
+
+    m_width = m_videoCodec->width;
+    m_height = m_videoCodec->height;
+    m_fps = av_q2d(av_guess_frame_rate(m_formatContext, stream, nullptr));
+    if (stream->nb_frames > 0) {
+        m_totalFrames = static_cast<int>(stream->nb_frames);
+    } else if (stream->duration > 0) {
+        m_totalFrames = static_cast<int>(stream->duration * av_q2d(stream->time_base) * m_fps);
+    }
+
+    // Frames are decoded in coded orientation; the rotation is carried over as metadata
+#if HAVE_CODECPAR_SIDE_DATA
+    const AVPacketSideData* sideData = av_packet_side_data_get(stream->codecpar->coded_side_data,
+                                                               stream->codecpar->nb_coded_side_data,
+                                                               AV_PKT_DATA_DISPLAYMATRIX);
+    const uint8_t* matrix = sideData ? sideData->data : nullptr;
+    size_t matrixSize = sideData ? sideData->size : 0;
+#else
+    size_t matrixSize = 0;
+    const uint8_t* matrix = av_stream_get_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX, &matrixSize);
+#endif
+    if (matrix && matrixSize >= sizeof(m_displayMatrix)) {
+        std::memcpy(m_displayMatrix.data(), matrix, sizeof(m_displayMatrix));
+        m_hasDisplayMatrix = true;
+    }
+
+    return true;
+}
+
+bool MediaDemuxer::openAudioDecoder() {
+    AVStream* stream = m_formatContext->streams[m_audioStreamIndex];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        std::cerr << "Unsupported audio codec" << std::endl;
+        return false;
+    }
+
+    m_audioCodec = avcodec_alloc_context3(codec);
+    m_audioFrame = av_frame_alloc();
+    if (!m_audioCodec || !m_audioFrame) {
+        std::cerr << "Failed to allocate audio codec context" << std::endl;
+        return false;
+    }
+
+    if (avcodec_parameters_to_context(m_audioCodec, stream->codecpar) < 0) {
+        std::cerr << "Failed to copy audio codec parameters to context" << std::endl;
+        return false;
+    }
+
+    if (avcodec_open2(m_audioCodec, codec, nullptr) < 0) {
+        std::cerr << "Failed to open audio codec" << std::endl;
+        return false;
+    }
+
+    if (m_audioCodec->sample_fmt == AV_SAMPLE_FMT_NONE) {
+        std::cerr << "Error: Input sample format is AV_SAMPLE_FMT_NONE (invalid/unknown). Cannot configure resampler." << std::endl;
+        std::cerr << "Codec: " << codec->name << " (ID: " << codec->id << ")" << std::endl;
+        return false;
+    }
+    std::cout << "Input sample format: " << av_get_sample_fmt_name(m_audioCodec->sample_fmt)
+              << " (ID: " << m_audioCodec->sample_fmt << ")" << std::endl;
+
+    m_sampleRate = m_audioCodec->sample_rate;
+    m_channels = m_audioCodec->ch_layout.nb_channels;
+
+    m_swrContext = swr_alloc();
+    if (!m_swrContext) {
+        std::cerr << "Failed to allocate resampler context" << std::endl;
+        return false;
+    }
+
+    av_opt_set_chlayout(m_swrContext, "in_chlayout", &m_audioCodec->ch_layout, 0);
+    av_opt_set_chlayout(m_swrContext, "out_chlayout", &m_audioCodec->ch_layout, 0);
+    av_opt_set_int(m_swrContext, "in_sample_rate", m_sampleRate, 0);
+    av_opt_set_int(m_swrContext, "out_sample_rate", m_sampleRate, 0);
+    av_opt_set_sample_fmt(m_swrContext, "in_sample_fmt", m_audioCodec->sample_fmt, 0);
+    av_opt_set_sample_fmt(m_swrContext, "out_sample_fmt", AV_SAMPLE_FMT_FLTP, 0);
+
+    if (swr_init(m_swrContext) < 0) {
+        std::cerr << "Failed to initialize resampler" << std::endl;
+        return false;
+    }
+
+    m_audioBuffer.assign(m_channels, nullptr);
+    return true;
+}
+
+bool MediaDemuxer::run(const VideoFrameHandler& onVideoFrame, const AudioPacketHandler& onAudioPacket) {
+    AVPacket* packet = av_packet_alloc();
+    if (!packet) {
+        std::cerr << "Failed to allocate AVPacket" << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    while (ok && av_read_frame(m_formatContext, packet) >= 0) {
+        if (packet->stream_index == m_videoStreamIndex) {
+            ok = decodeVideo(packet, onVideoFrame);
+        } else if (packet->stream_index == m_audioStreamIndex && hasAudio()) {
+            // The payload is reference counted, so handing it on does not copy it
+            PacketPtr audioPacket(av_packet_alloc());
+            if (!audioPacket) {
+                std::cerr << "Failed to allocate AVPacket" << std::endl;
+                ok = false;
+            } else {
+                av_packet_move_ref(audioPacket.get(), packet);
+                ok = onAudioPacket(std::move(audioPacket));
+            }
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    // Drain frames still buffered in the decoder
+    return ok && decodeVideo(nullptr, onVideoFrame);
+}
+
+bool MediaDemuxer::decodeVideo(const AVPacket* packet, const VideoFrameHandler& onVideoFrame) {
+    int sent;
+    {
+        StageTimer timer(&m_videoDecodeTime);
+        sent = avcodec_send_packet(m_videoCodec, packet);
+    }
+    if (sent < 0 && packet) {
+        // Like cv::VideoCapture, a damaged packet is skipped rather than ending the read
+        std::cerr << "Warning: Skipping undecodable video packet" << std::endl;
+        return true;
+    }
+
+    const bool planar = m_frameFormat == FrameFormat::Yuv420;
+    while (true) {
+        // The handler may block on a full queue, so it is kept out of the decode time
+        StageTimer timer(&m_videoDecodeTime);
+        if (avcodec_receive_frame(m_videoCodec, m_videoFrame) < 0) {
+            break;
+        }
+
+        int width = m_videoFrame->width;
+        int height = m_videoFrame->height;
+        m_swsContext = sws_getCachedContext(m_swsContext, width, height,
+                                            static_cast<AVPixelFormat>(m_videoFrame->format), width, height,
+                                            planar ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_BGR24, SWS_BILINEAR,
+                                            nullptr, nullptr, nullptr);
+        if (!m_swsContext) {
+            std::cerr << "Failed to create video frame converter" << std::endl;
+            av_frame_unref(m_videoFrame);
+            return false;
+        }
+
+        // Each frame gets its own buffer since it is handed to another thread;
+        // with a pool that buffer comes back once the frame has been encoded
+        int rows = planar ? height * 3 / 2 : height;
+        int type = planar ? CV_8UC1 : CV_8UC3;
+        cv::Mat image = m_framePool ? m_framePool->acquire(rows, width, type) : cv::Mat(rows, width, type);
+
+        // For yuv420p sources the converter only copies the planes. swscale
+        // reads four plane entries, so the arrays are sized to match.
+        uint8_t* destData[4] = {image.data, nullptr, nullptr, nullptr};
+        int destStride[4] = {static_cast<int>(image.step[0]), 0, 0, 0};
+        if (planar) {
+            destData[1] = image.data + width * height;
+            destData[2] = destData[1] + (width / 2) * (height / 2);
+            destStride[1] = width / 2;
+            destStride[2] = width / 2;
+        }
+        sws_scale(m_swsContext, m_videoFrame->data, m_videoFrame->linesize, 0, height, destData, destStride);
+        av_frame_unref(m_videoFrame);
+        timer.setItems(1);
+        timer.stop();
+
+        if (!onVideoFrame(image)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MediaDemuxer::collectStageTimes(PipelineStats& stats) const {
+    stats.add(PipelineStage::VideoDecode, m_videoDecodeTime);
+    stats.add(PipelineStage::AudioDecode, m_audioDecodeTime);
+    stats.add(PipelineStage::Resample, m_resampleTime);
+}
+
+bool MediaDemuxer::decodeAudio(const AVPacket* packet, const AudioBlockHandler& onBlock) {
+    int sent;
+    {
+        StageTimer timer(&m_audioDecodeTime);
+        sent = avcodec_send_packet(m_audioCodec, packet);
+    }
+    if (sent < 0 && packet) {
+        return true;
+    }
+
+    while (true) {
+        StageTimer decodeTimer(&m_audioDecodeTime);
+        if (avcodec_receive_frame(m_audioCodec, m_audioFrame) < 0) {
+            break;
+        }
+
+        // The conversion buffer is reused and only grows for larger frames
+        int samples = m_audioFrame->nb_samples;
+        if (samples > m_audioBufferSamples) {
+            av_freep(&m_audioBuffer[0]);
+            if (av_samples_alloc(m_audioBuffer.data(), nullptr, m_channels, samples, AV_SAMPLE_FMT_FLTP, 0) < 0) {
+                std::cerr << "Failed to allocate sample buffer" << std::endl;
+                m_audioBufferSamples = 0;
+                av_frame_unref(m_audioFrame);
+                return false;
+            }
+            m_audioBufferSamples = samples;
+        }
+        decodeTimer.setItems(static_cast<uint64_t>(samples) * m_channels);
+        decodeTimer.stop();
+
+        StageTimer resampleTimer(&m_resampleTime);
+        int converted = swr_convert(m_swrContext, m_audioBuffer.data(), samples,
+                                    const_cast<const uint8_t**>(m_audioFrame->extended_data), samples);
+        av_frame_unref(m_audioFrame);
+        resampleTimer.setItems(converted > 0 ? static_cast<uint64_t>(converted) * m_channels : 0);
+        resampleTimer.stop();
+
+        if (converted > 0 && !onBlock(reinterpret_cast<const float* const*>(m_audioBuffer.data()), converted)) {
+            return false;
+        }
+    }
+    return true;
+}
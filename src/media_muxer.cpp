@@ -0,0 +1,458 @@
+#include "media_muxer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/error.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+// Stream side data moved into AVCodecParameters in FFmpeg 6.1
+#define HAVE_CODECPAR_SIDE_DATA (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(60, 31, 102))
+
+// AVCodec::pix_fmts was replaced by avcodec_get_supported_config() in FFmpeg 7.1
+#define HAVE_SUPPORTED_CONFIG (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100))
+
+static std::string errorString(int errorCode) {
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(errorCode, buffer, sizeof(buffer));
+    return buffer;
+}
+
+MediaMuxer::MediaMuxer() {
+}
+
+MediaMuxer::~MediaMuxer() {
+    sws_freeContext(m_swsContext);
+    av_frame_free(&m_videoFrame);
+    av_packet_free(&m_videoPacket);
+    avcodec_free_context(&m_videoCodec);
+
+    if (m_audioFifo) {
+        av_audio_fifo_free(m_audioFifo);
+    }
+    av_frame_free(&m_audioFrame);
+    av_packet_free(&m_audioPacket);
+    avcodec_free_context(&m_audioCodec);
+
+    if (m_formatContext) {
+        if (!(m_formatContext->oformat->flags & AVFMT_NOFILE) && m_formatContext->pb) {
+            avio_closep(&m_formatContext->pb);
+        }
+        avformat_free_context(m_formatContext);
+    }
+}
+
+bool MediaMuxer::open(const std::string& outputPath) {
+    m_outputPath = outputPath;
+    int ret = avformat_alloc_output_context2(&m_formatContext, nullptr, nullptr, outputPath.c_str());
+    if (ret < 0 || !m_formatContext) {
+        std::cerr << "Could not choose an output format for " << outputPath << ": " << errorString(ret) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Looks up an encoder by its own name, then by codec name; libx264 falls back to any H.264 encoder
+static const AVCodec* findVideoEncoder(const std::string& name) {
+    const AVCodec* codec = avcodec_find_encoder_by_name(name.c_str());
+    if (!codec) {
+        const AVCodecDescriptor* descriptor = avcodec_descriptor_get_by_name(name.c_str());
+        if (descriptor) {
+            codec = avcodec_find_encoder(descriptor->id);
+        }
+    }
+    if (!codec && name == "libx264") {
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    }
+    return codec;
+}
+
+// Frames reach the encoder as YUV420P; encoders that do not list their formats are given the benefit of the doubt
+static bool supportsYuv420p(const AVCodec* codec) {
+    const enum AVPixelFormat* formats = nullptr;
+#if HAVE_SUPPORTED_CONFIG
+    int count = 0;
+    if (avcodec_get_supported_config(nullptr, codec, AV_CODEC_CONFIG_PIX_FORMAT, 0,
+                                     reinterpret_cast<const void**>(&formats), &count) < 0) {
+        return true;
+    }
+#else
+    formats = codec->pix_fmts;
+#endif
+    if (!formats) {
+        return true;
+    }
+    for (const enum AVPixelFormat* format = formats; *format != AV_PIX_FMT_NONE; format++) {
+        if (*format == AV_PIX_FMT_YUV420P) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MediaMuxer::addVideoStream(int width, int height, double fps, const EncoderSettings& settings,
+                                const int32_t* displayMatrix) {
+    const AVCodec* codec = findVideoEncoder(settings.codec);
+    if (!codec) {
+        std::cerr << "No " << settings.codec << " video encoder available in the linked FFmpeg libraries" << std::endl;
+        return false;
+    }
+    if (codec->type != AVMEDIA_TYPE_VIDEO) {
+        std::cerr << "Encoder " << codec->name << " is not a video encoder" << std::endl;
+        return false;
+    }
+    if (!supportsYuv420p(codec)) {
+        std::cerr << "Encoder " << codec->name << " does not accept YUV 4:2:0 (yuv420p) input" << std::endl;
+        return false;
+    }
+
+    m_videoStream = avformat_new_stream(m_formatContext, nullptr);
+    m_videoCodec = avcodec_alloc_context3(codec);
+    m_videoFrame = av_frame_alloc();
+    m_videoPacket = av_packet_alloc();
+    if (!m_videoStream || !m_videoCodec || !m_videoFrame || !m_videoPacket) {
+        std::cerr << "Failed to allocate video encoder" << std::endl;
+        return false;
+    }
+
+    AVRational frameRate = av_d2q(fps, 100000);
+    m_videoCodec->width = width;
+    m_videoCodec->height = height;
+    m_videoCodec->pix_fmt = AV_PIX_FMT_YUV420P;
+    m_videoCodec->framerate = frameRate;
+    m_videoCodec->time_base = av_inv_q(frameRate);
+    if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        m_videoCodec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    // Left unset, the encoder keeps FFmpeg's single thread. Thread count changes
+    // x264's lookahead and rate control, and with them the bitstream.
+    if (settings.threads >= 0) {
+        m_videoCodec->thread_count = settings.threads;
+        m_videoCodec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+    if (settings.gopSize > 0) {
+        m_videoCodec->gop_size = settings.gopSize;
+    }
+    if (settings.bitrate > 0) {
+        m_videoCodec->bit_rate = settings.bitrate;
+    }
+
+    // Preset and CRF are private encoder options; ones the encoder does not know are reported below
+    AVDictionary* encoderOptions = nullptr;
+    if (!settings.preset.empty()) {
+        av_dict_set(&encoderOptions, "preset", settings.preset.c_str(), 0);
+    }
+    if (settings.crf >= 0 && settings.bitrate <= 0) {
+        av_dict_set_int(&encoderOptions, "crf", settings.crf, 0);
+    }
+
+    int ret = avcodec_open2(m_videoCodec, codec, &encoderOptions);
+    if (ret < 0) {
+        av_dict_free(&encoderOptions);
+        std::cerr << "Failed to open video encoder " << codec->name << ": " << errorString(ret) << std::endl;
+        return false;
+    }
+
+    const AVDictionaryEntry* unused = nullptr;
+    while ((unused = av_dict_get(encoderOptions, "", unused, AV_DICT_IGNORE_SUFFIX))) {
+        std::cerr << "Warning: Encoder " << codec->name << " does not support option " << unused->key << std::endl;
+    }
+    av_dict_free(&encoderOptions);
+
+    avcodec_parameters_from_context(m_videoStream->codecpar, m_videoCodec);
+    m_videoStream->time_base = m_videoCodec->time_base;
+    m_videoStream->avg_frame_rate = frameRate;
+
+    if (displayMatrix) {
+        const size_t matrixSize = 9 * sizeof(int32_t);
+#if HAVE_CODECPAR_SIDE_DATA
+        AVPacketSideData* sideData = av_packet_side_data_new(&m_videoStream->codecpar->coded_side_data,
+                                                             &m_videoStream->codecpar->nb_coded_side_data,
+                                                             AV_PKT_DATA_DISPLAYMATRIX, matrixSize, 0);
+        uint8_t* matrix = sideData ? sideData->data : nullptr;
+#else
+        uint8_t* matrix = av_stream_new_side_data(m_videoStream, AV_PKT_DATA_DISPLAYMATRIX, matrixSize);
+#endif
+        if (matrix) {
+            std::memcpy(matrix, displayMatrix, matrixSize);
+        }
+    }
+
+    m_videoFrame->format = m_videoCodec->pix_fmt;
+    m_videoFrame->width = width;
+    m_videoFrame->height = height;
+    if (av_frame_get_buffer(m_videoFrame, 0) < 0) {
+        std::cerr << "Failed to allocate video frame buffer" << std::endl;
+        return false;
+    }
+
+    m_swsContext = sws_getContext(width, height, AV_PIX_FMT_BGR24, width, height, m_videoCodec->pix_fmt,
+                                  SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsContext) {
+        std::cerr << "Failed to create BGR to YUV converter" << std::endl;
+        return false;
+    }
+
+    std::cout << "Video encoder: " << codec->name << " " << width << "x" << height << " @ " << fps << " fps";
+    if (!settings.preset.empty()) {
+        std::cout << ", preset " << settings.preset;
+    }
+    if (settings.bitrate > 0) {
+        std::cout << ", " << settings.bitrate / 1000 << " kbit/s";
+    } else if (settings.crf >= 0) {
+        std::cout << ", CRF " << settings.crf;
+    }
+    if (settings.gopSize > 0) {
+        std::cout << ", GOP " << settings.gopSize;
+    }
+    std::cout << ", " << (settings.threads > 0 ? std::to_string(settings.threads) : std::string("auto"))
+              << " thread(s)" << std::endl;
+    return true;
+}
+
+bool MediaMuxer::addAudioStream(int sampleRate, int channels) {
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    if (!codec) {
+        std::cerr << "No AAC encoder available in the linked FFmpeg libraries" << std::endl;
+        return false;
+    }
+
+    m_audioStream = avformat_new_stream(m_formatContext, nullptr);
+    m_audioCodec = avcodec_alloc_context3(codec);
+    m_audioFrame = av_frame_alloc();
+    m_audioPacket = av_packet_alloc();
+    if (!m_audioStream || !m_audioCodec || !m_audioFrame || !m_audioPacket) {
+        std::cerr << "Failed to allocate audio encoder" << std::endl;
+        return false;
+    }
+
+    m_audioCodec->sample_rate = sampleRate;
+    av_channel_layout_default(&m_audioCodec->ch_layout, channels);
+    m_audioCodec->sample_fmt = AV_SAMPLE_FMT_FLTP;
+    m_audioCodec->bit_rate = 64000 * channels;
+    m_audioCodec->time_base = av_make_q(1, sampleRate);
+    if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        m_audioCodec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    int ret = avcodec_open2(m_audioCodec, codec, nullptr);
+    if (ret < 0) {
+        std::cerr << "Failed to open audio encoder " << codec->name << ": " << errorString(ret) << std::endl;
+        return false;
+    }
+
+    avcodec_parameters_from_context(m_audioStream->codecpar, m_audioCodec);
+    m_audioStream->time_base = m_audioCodec->time_base;
+
+    // The encoder consumes fixed-size frames, so blocks are queued until one is full
+    bool variableFrameSize = (codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) != 0;
+    m_audioFrameSize = (variableFrameSize || m_audioCodec->frame_size <= 0) ? 1024 : m_audioCodec->frame_size;
+    m_audioFifo = av_audio_fifo_alloc(AV_SAMPLE_FMT_FLTP, channels, m_audioFrameSize);
+
+    m_audioFrame->format = AV_SAMPLE_FMT_FLTP;
+    m_audioFrame->sample_rate = sampleRate;
+    m_audioFrame->nb_samples = m_audioFrameSize;
+    av_channel_layout_copy(&m_audioFrame->ch_layout, &m_audioCodec->ch_layout);
+    if (!m_audioFifo || av_frame_get_buffer(m_audioFrame, 0) < 0) {
+        std::cerr << "Failed to allocate audio frame buffer" << std::endl;
+        return false;
+    }
+
+    std::cout << "Audio encoder: " << codec->name << " " << sampleRate << " Hz, " << channels << " channel(s)"
+              << std::endl;
+    return true;
+}
+
+bool MediaMuxer::writeHeader() {
+    if (!(m_formatContext->oformat->flags & AVFMT_NOFILE)) {
+        int ret = avio_open(&m_formatContext->pb, m_outputPath.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            std::cerr << "Could not open output file " << m_outputPath << ": " << errorString(ret) << std::endl;
+            return false;
+        }
+    }
+
+    // Matches ffmpeg -shortest: the output ends with the shorter stream. The
+    // interleaver holds the longer stream's packets until the other stream
+    // catches up, and drops whatever is still held when the trailer is written.
+    // A limit of 0 keeps it from flushing the tail early; the reader thread
+    // keeps the two branches close, so only the tail is ever held.
+    if (m_videoStream && m_audioStream) {
+        m_formatContext->flags |= AVFMT_FLAG_SHORTEST;
+        m_formatContext->max_interleave_delta = 0;
+    }
+
+    int ret = avformat_write_header(m_formatContext, nullptr);
+    if (ret < 0) {
+        std::cerr << "Failed to write container header: " << errorString(ret) << std::endl;
+        return false;
+    }
+
+    m_headerWritten = true;
+    return true;
+}
+
+bool MediaMuxer::writeVideoFrame(const cv::Mat& frame) {
+    const int width = m_videoCodec->width;
+    const int height = m_videoCodec->height;
+    bool planar = frame.type() == CV_8UC1 && frame.rows == height * 3 / 2 && frame.isContinuous();
+    bool packed = frame.type() == CV_8UC3 && frame.rows == height;
+    if (frame.cols != width || (!planar && !packed)) {
+        std::cerr << "Video frame does not match the output stream format" << std::endl;
+        return false;
+    }
+
+    // Colour conversion into the encoder's frame counts as part of encoding
+    StageTimer timer(&m_videoEncodeTime, 1);
+
+    // The encoder may still hold a reference to the previous frame's buffers
+    if (av_frame_make_writable(m_videoFrame) < 0) {
+        std::cerr << "Failed to make video frame writable" << std::endl;
+        return false;
+    }
+
+    if (planar) {
+        // I420 frames already match the encoder's format, so the planes are copied as they are
+        const uint8_t* luma = frame.data;
+        const uint8_t* blue = luma + width * height;
+        const uint8_t* red = blue + (width / 2) * (height / 2);
+        av_image_copy_plane(m_videoFrame->data[0], m_videoFrame->linesize[0], luma, width, width, height);
+        av_image_copy_plane(m_videoFrame->data[1], m_videoFrame->linesize[1], blue, width / 2, width / 2, height / 2);
+        av_image_copy_plane(m_videoFrame->data[2], m_videoFrame->linesize[2], red, width / 2, width / 2, height / 2);
+    } else {
+        const uint8_t* sourceData[4] = {frame.data, nullptr, nullptr, nullptr};
+        int sourceStride[4] = {static_cast<int>(frame.step[0]), 0, 0, 0};
+        sws_scale(m_swsContext, sourceData, sourceStride, 0, frame.rows, m_videoFrame->data, m_videoFrame->linesize);
+    }
+
+    m_videoFrame->pts = m_videoFramesWritten++;
+    return encode(m_videoCodec, m_videoStream, m_videoFrame, m_videoPacket, m_videoEncodeTime);
+}
+
+bool MediaMuxer::writeAudio(const float* const* channelData, int numSamples) {
+    void* const* planes = reinterpret_cast<void* const*>(const_cast<float**>(channelData));
+    if (av_audio_fifo_write(m_audioFifo, planes, numSamples) < numSamples) {
+        std::cerr << "Failed to queue audio samples for encoding" << std::endl;
+        return false;
+    }
+
+    while (av_audio_fifo_size(m_audioFifo) >= m_audioFrameSize) {
+        if (!encodeAudioFrame(m_audioFrameSize)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MediaMuxer::encodeAudioFrame(int numSamples) {
+    StageTimer timer(&m_audioEncodeTime, static_cast<uint64_t>(numSamples) * m_audioCodec->ch_layout.nb_channels);
+    if (av_frame_make_writable(m_audioFrame) < 0) {
+        std::cerr << "Failed to make audio frame writable" << std::endl;
+        return false;
+    }
+
+    m_audioFrame->nb_samples = numSamples;
+    if (av_audio_fifo_read(m_audioFifo, reinterpret_cast<void**>(m_audioFrame->data), numSamples) < numSamples) {
+        std::cerr << "Failed to read queued audio samples" << std::endl;
+        return false;
+    }
+
+    m_audioFrame->pts = m_audioSamplesWritten;
+    m_audioSamplesWritten += numSamples;
+    return encode(m_audioCodec, m_audioStream, m_audioFrame, m_audioPacket, m_audioEncodeTime);
+}
+
+bool MediaMuxer::encode(AVCodecContext* codecContext, AVStream* stream, AVFrame* frame, AVPacket* packet,
+                        StageTime& encodeTime) {
+    // A null frame drains the encoder
+    int ret = avcodec_send_frame(codecContext, frame);
+    if (ret < 0) {
+        std::cerr << "Failed to send frame to " << codecContext->codec->name << " encoder: "
+                  << errorString(ret) << std::endl;
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_packet(codecContext, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret < 0) {
+            std::cerr << "Failed to encode " << codecContext->codec->name << " packet: " << errorString(ret)
+                      << std::endl;
+            return false;
+        }
+
+        av_packet_rescale_ts(packet, codecContext->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+
+        // Both streams share the container; the interleaver takes ownership of the packet.
+        // The caller is timing this call as encoding, so the write (and any wait
+        // for the other stream) is taken back out of that time.
+        double writeStart = monotonicSeconds();
+        double writeCpuStart = threadCpuSeconds();
+        {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            StageTimer timer(&m_muxTime, 1);
+            ret = av_interleaved_write_frame(m_formatContext, packet);
+        }
+        encodeTime.wallSeconds -= monotonicSeconds() - writeStart;
+        encodeTime.callerCpuSeconds -= threadCpuSeconds() - writeCpuStart;
+        if (ret < 0) {
+            std::cerr << "Failed to write packet to " << m_outputPath << ": " << errorString(ret) << std::endl;
+            return false;
+        }
+    }
+}
+
+void MediaMuxer::collectStageTimes(PipelineStats& stats) const {
+    stats.add(PipelineStage::AudioEncode, m_audioEncodeTime);
+    stats.add(PipelineStage::VideoEncode, m_videoEncodeTime);
+    stats.add(PipelineStage::Mux, m_muxTime);
+}
+
+bool MediaMuxer::finish() {
+    if (!m_headerWritten) {
+        return false;
+    }
+
+    if (m_audioCodec) {
+        // The last audio frame may be shorter than the encoder frame size
+        int remaining = av_audio_fifo_size(m_audioFifo);
+        if (remaining > 0 && !encodeAudioFrame(remaining)) {
+            return false;
+        }
+        StageTimer timer(&m_audioEncodeTime);
+        if (!encode(m_audioCodec, m_audioStream, nullptr, m_audioPacket, m_audioEncodeTime)) {
+            return false;
+        }
+    }
+
+    if (m_videoCodec) {
+        StageTimer timer(&m_videoEncodeTime);
+        if (!encode(m_videoCodec, m_videoStream, nullptr, m_videoPacket, m_videoEncodeTime)) {
+            return false;
+        }
+    }
+
+    StageTimer timer(&m_muxTime);
+    int ret = av_write_trailer(m_formatContext);
+    if (ret < 0) {
+        std::cerr << "Failed to write container trailer: " << errorString(ret) << std::endl;
+        return false;
+    }
+
+    if (!(m_formatContext->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&m_formatContext->pb);
+    }
+    return true;
+}
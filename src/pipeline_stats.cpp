@@ -0,0 +1,135 @@
+#include "pipeline_stats.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static std::string jsonString(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped + "\"";
+}
+
+void PipelineStats::add(PipelineStage stage, const StageTime& time) {
+    m_stages[static_cast<size_t>(stage)] += time;
+}
+
+void PipelineStats::setTotals(double wallSeconds, double cpuSeconds) {
+    m_wallSeconds = wallSeconds;
+    m_cpuSeconds = cpuSeconds;
+}
+
+void PipelineStats::setInfo(const std::string& key, const std::string& value) {
+    for (auto& entry : m_info) {
+        if (entry.first == key) {
+            entry.second = value;
+            return;
+        }
+    }
+    m_info.emplace_back(key, value);
+}
+
+const char* PipelineStats::stageName(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::AudioDecode: return "audio_decode";
+        case PipelineStage::Resample: return "resample";
+        case PipelineStage::BandPass: return "fir";
+        case PipelineStage::SpectralSubtraction: return "stft";
+        case PipelineStage::AudioEncode: return "audio_encode";
+        case PipelineStage::VideoDecode: return "video_decode";
+        case PipelineStage::Denoise: return "denoise";
+        case PipelineStage::VideoEncode: return "video_encode";
+        case PipelineStage::Mux: return "mux";
+        default: return "unknown";
+    }
+}
+
+const char* PipelineStats::stageUnit(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::VideoDecode:
+        case PipelineStage::Denoise:
+        case PipelineStage::VideoEncode:
+            return "frames";
+        case PipelineStage::Mux:
+            return "packets";
+        default:
+            return "samples";
+    }
+}
+
+void PipelineStats::print(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "Stage times (wall summed over threads, cpu of the calling thread only):" << std::endl;
+    for (size_t i = 0; i < m_stages.size(); i++) {
+        const StageTime& time = m_stages[i];
+        if (time.wallSeconds <= 0 && time.items == 0) {
+            continue;
+        }
+        PipelineStage stage = static_cast<PipelineStage>(i);
+        double rate = time.wallSeconds > 0 ? time.items / time.wallSeconds : 0.0;
+        out << "  " << std::left << std::setw(14) << stageName(stage) << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << time.wallSeconds << " s wall"
+            << std::setw(10) << time.callerCpuSeconds << " s cpu"
+            << std::setprecision(1) << std::setw(14) << rate << " " << stageUnit(stage) << "/s" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool PipelineStats::writeJson(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Could not open stats file: " << path << std::endl;
+        return false;
+    }
+
+    file << std::setprecision(9);
+    file << "{\n";
+    for (const auto& entry : m_info) {
+        file << "  " << jsonString(entry.first) << ": " << jsonString(entry.second) << ",\n";
+    }
+    file << "  \"wall_seconds\": " << m_wallSeconds << ",\n";
+    file << "  \"process_cpu_seconds\": " << m_cpuSeconds << ",\n";
+    file << "  \"stages\": {";
+
+    bool first = true;
+    for (size_t i = 0; i < m_stages.size(); i++) {
+        const StageTime& time = m_stages[i];
+        PipelineStage stage = static_cast<PipelineStage>(i);
+        double rate = time.wallSeconds > 0 ? time.items / time.wallSeconds : 0.0;
+        file << (first ? "\n" : ",\n");
+        file << "    " << jsonString(stageName(stage)) << ": {"
+             << "\"wall_seconds\": " << time.wallSeconds
+             << ", \"caller_cpu_seconds\": " << time.callerCpuSeconds
+             << ", \"items\": " << time.items
+             << ", \"unit\": " << jsonString(stageUnit(stage))
+             << ", \"items_per_second\": " << rate << "}";
+        first = false;
+    }
+    file << "\n  }\n}\n";
+
+    file.close();
+    if (!file) {
+        std::cerr << "Failed to write stats file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
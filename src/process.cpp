@@ -4,471 +4,480 @@
 #include <vector>
 #include <memory>
 #include <stdexcept>
-#include <fstream>
 #include <string>  
-#include <cstdio>  
 #include <cstdint> 
-#include <unistd.h>
-#include <sys/wait.h>
-#include <fcntl.h>
-
-extern "C" {
-#include <libavcodec/avcodec.h>
-#include <libavformat/avformat.h>
-#include <libavutil/avutil.h>
-#include <libavutil/opt.h>
-#include <libavutil/channel_layout.h>
-#include <libswresample/swresample.h>
-}
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <chrono>
 
 #include "video_denoise.h"
+#include "frame_pool.h"
+#include "media_muxer.h"
+#include "thread_pool.h"
 #include "filters.h"
+#include "bounded_queue.h"
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 
-VideoProcessor::VideoProcessor(float lowCutoff, float highCutoff, float noiseReduction, float videoDenoiseStrength)
+// About five seconds of typical AAC packets
+constexpr size_t kAudioPacketQueueDepth = 256;
+
+VideoProcessor::VideoProcessor(float lowCutoff, float highCutoff, float noiseReduction, float videoDenoiseStrength,
+                               int numThreads, const VideoDenoiserOptions& denoiserOptions,
+                               const EncoderSettings& encoderSettings)
     : m_lowCutoff(lowCutoff), m_highCutoff(highCutoff), m_noiseReduction(noiseReduction),
-      m_videoDenoiseStrength(videoDenoiseStrength) {
+      m_videoDenoiseStrength(videoDenoiseStrength), m_numThreads(std::max(1, numThreads)),
+      m_denoiserOptions(denoiserOptions), m_encoderSettings(encoderSettings) {
 
-    m_audioProcessor = nullptr;
-    m_videoDenoiser = createVideoDenoiser(videoDenoiseStrength);
+    m_videoDenoiser = createVideoDenoiser(videoDenoiseStrength, m_denoiserOptions);
+    m_videoDenoiserPlanar = m_denoiserOptions.planarYuv;
 }
 
+VideoProcessor::~VideoProcessor() = default;
+
 bool VideoProcessor::processVideo(const std::string& inputPath, const std::string& outputPath) {
     try {
-        std::vector<float> audioData;
-        int sampleRate = 0;
-        int channels = 0;
+        auto wallStart = std::chrono::steady_clock::now();
+        double cpuStart = processCpuSeconds();
+        m_frameLatencies.clear();
 
-        if (!extractAudio(inputPath, audioData, sampleRate, channels)) {
-            std::cerr << "Failed to extract audio from video" << std::endl;
+        MediaDemuxer demuxer;
+        if (!demuxer.open(inputPath)) {
+            std::cerr << "Could not open input video: " << inputPath << std::endl;
             return false;
         }
 
-        if (!processAudio(audioData, sampleRate, channels)) {
-            std::cerr << "Failed to process audio" << std::endl;
+        if (demuxer.fps() <= 0) {
+            std::cerr << "Error: Invalid FPS (" << demuxer.fps() << ") from input video." << std::endl;
             return false;
         }
 
-        if (!processVideoFrames(inputPath, outputPath, audioData, sampleRate, channels)) {
-            std::cerr << "Failed to process video frames" << std::endl;
-            return false;
+        // Silent clips (screen captures, generated test clips) are written without an audio track
+        const bool withAudio = demuxer.hasAudio();
+        if (!withAudio) {
+            std::cerr << "Warning: No decodable audio stream, writing video only" << std::endl;
+            m_channelProcessors.clear();
         }
 
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing video: " << e.what() << std::endl;
-        return false;
-    }
-}
-
-bool VideoProcessor::extractAudio(const std::string& videoPath, std::vector<float>& audioData, int& sampleRate, int& channels) {
-    AVFormatContext* formatContext = nullptr;
-    AVCodecContext* codecContext = nullptr;
-    AVStream* audioStream = nullptr;
-    const AVCodec* codec = nullptr;
-    SwrContext* swrContext = nullptr;
-
-    if (avformat_open_input(&formatContext, videoPath.c_str(), nullptr, nullptr) != 0) {
-        std::cerr << "Could not open input file: " << videoPath << std::endl;
-        return false;
-    }
-
-    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-        std::cerr << "Could not find stream information" << std::endl;
-        avformat_close_input(&formatContext);
-        return false;
-    }
-
-    int audioStreamIndex = -1;
-    for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
-        if (formatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            audioStreamIndex = i;
-            break;
+        // I420 keeps chroma at half resolution, so both dimensions must be even.
+        // The fallback only applies to this input; later calls start from the
+        // configured options again.
+        VideoDenoiserOptions denoiserOptions = m_denoiserOptions;
+        if (denoiserOptions.planarYuv) {
+            if (demuxer.width() % 2 != 0 || demuxer.height() % 2 != 0) {
+                std::cerr << "Warning: Odd frame size, processing in BGR instead of planar YUV" << std::endl;
+                denoiserOptions.planarYuv = false;
+            } else {
+                demuxer.setFrameFormat(FrameFormat::Yuv420);
+            }
+        }
+        if (m_videoDenoiserPlanar != denoiserOptions.planarYuv) {
+            m_videoDenoiser = createVideoDenoiser(m_videoDenoiseStrength, denoiserOptions);
+            m_videoDenoiserPlanar = denoiserOptions.planarYuv;
         }
-    }
-    
-    if (audioStreamIndex == -1) {
-        std::cerr << "Could not find audio stream in video file" << std::endl;
-        avformat_close_input(&formatContext);
-        return false;
-    }
-
-    audioStream = formatContext->streams[audioStreamIndex];
 
-    codec = avcodec_find_decoder(audioStream->codecpar->codec_id);
-    if (!codec) {
-        std::cerr << "Unsupported audio codec" << std::endl;
-        avformat_close_input(&formatContext);
-        return false;
-    }
+        // The first frame re-initializes the denoiser, so temporal history and
+        // change detection references from an earlier input are dropped
+        m_lastFrameWidth = 0;
+        m_lastFrameHeight = 0;
+
+        // Both streams are encoded in-process and interleaved straight into
+        // the final file, so nothing is staged on disk.
+        MediaMuxer muxer;
+        if (!muxer.open(outputPath) ||
+            !muxer.addVideoStream(demuxer.width(), demuxer.height(), demuxer.fps(), m_encoderSettings,
+                                  demuxer.displayMatrix()) ||
+            (withAudio && !muxer.addAudioStream(demuxer.sampleRate(), demuxer.channels())) ||
+            !muxer.writeHeader()) {
+            std::cerr << "Failed to set up output file: " << outputPath << std::endl;
+            return false;
+        }
 
-    codecContext = avcodec_alloc_context3(codec);
-    if (!codecContext) {
-        std::cerr << "Failed to allocate audio codec context" << std::endl;
-        avformat_close_input(&formatContext);
-        return false;
-    }
+        if (withAudio && !beginAudioProcessing(demuxer.sampleRate(), demuxer.channels())) {
+            return false;
+        }
 
-    if (avcodec_parameters_to_context(codecContext, audioStream->codecpar) < 0) {
-        std::cerr << "Failed to copy audio codec parameters to context" << std::endl;
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return false;
-    }
+        // Every input packet is read exactly once. Video is decoded on the
+        // reader thread and feeds the frame loop; audio packets go to the audio
+        // branch, which decodes and cleans them alongside the frame loop.
+        FrameQueue decodedFrames(static_cast<size_t>(m_numThreads) * 2);
+        AudioPacketQueue audioPackets(kAudioPacketQueueDepth);
+
+        // Decoded and denoised frames return to the pool once encoded. Enough
+        // buffers are kept for every frame that can be in flight at once: the
+        // decode queue and reorder window (2 per worker each), one input and
+        // one output per worker, plus the reader and the writer.
+        FramePool framePool(static_cast<size_t>(m_numThreads) * 6 + 2);
+        demuxer.setFramePool(&framePool);
+
+        bool readOk = false;
+        std::thread reader([&]() {
+            size_t index = 0;
+            try {
+                readOk = demuxer.run(
+                    [&](cv::Mat& frame) {
+                        return decodedFrames.push({index++, std::move(frame), monotonicSeconds()});
+                    },
+                    [&](PacketPtr packet) { return audioPackets.push(std::move(packet)); });
+            } catch (const std::exception& e) {
+                std::cerr << "Input reader failed: " << e.what() << std::endl;
+            }
+            decodedFrames.close();
+            audioPackets.close();
+        });
+
+        double audioSeconds = 0.0;
+        std::future<bool> audioTask = std::async(std::launch::async, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            bool ok = !withAudio;
+            try {
+                ok = ok || processAudioBranch(demuxer, audioPackets, muxer);
+            } catch (const std::exception& e) {
+                std::cerr << "Audio branch failed: " << e.what() << std::endl;
+            }
+            // Stops the reader if the branch gave up early
+            audioPackets.close();
+            audioSeconds = secondsSince(start);
+            return ok;
+        });
+
+        auto videoStart = std::chrono::steady_clock::now();
+        bool videoOk = false;
+        try {
+            videoOk = processVideoFrames(decodedFrames, framePool, muxer, demuxer.totalFrames(), denoiserOptions);
+        } catch (const std::exception& e) {
+            std::cerr << "Frame processing failed: " << e.what() << std::endl;
+        }
+        decodedFrames.close();
+        double videoSeconds = secondsSince(videoStart);
 
-    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
-        std::cerr << "Failed to open audio codec" << std::endl;
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return false;
-    }
+        bool audioOk = audioTask.get();
+        reader.join();
+        double wallSeconds = secondsSince(wallStart);
 
-    sampleRate = codecContext->sample_rate;
-    channels = codecContext->ch_layout.nb_channels;
+        std::cout << "Audio branch: " << audioSeconds << " s, video branch: " << videoSeconds
+                  << " s, wall time: " << wallSeconds << " s (overlap saved "
+                  << std::max(0.0, audioSeconds + videoSeconds - wallSeconds) << " s)" << std::endl;
 
-    swrContext = swr_alloc();
-    if (!swrContext) {
-        std::cerr << "Failed to allocate resampler context" << std::endl;
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return false;
-    }
+        if (!audioOk) {
+            std::cerr << "Failed to process audio" << std::endl;
+            return false;
+        }
 
-    av_opt_set_int(swrContext, "in_channel_count", codecContext->ch_layout.nb_channels, 0);
-    av_opt_set_int(swrContext, "out_channel_count", codecContext->ch_layout.nb_channels, 0);
-    av_opt_set_chlayout(swrContext, "in_chlayout", &codecContext->ch_layout, 0);
-    av_opt_set_chlayout(swrContext, "out_chlayout", &codecContext->ch_layout, 0);
-    av_opt_set_int(swrContext, "in_sample_rate", codecContext->sample_rate, 0);
-    av_opt_set_int(swrContext, "out_sample_rate", codecContext->sample_rate, 0);
-
-    if (codecContext->sample_fmt == AV_SAMPLE_FMT_NONE) {
-        std::cerr << "Error: Input sample format is AV_SAMPLE_FMT_NONE (invalid/unknown). Cannot configure resampler." << std::endl;
-        std::cerr << "Codec: " << codec->name << " (ID: " << codec->id << ")" << std::endl;
-        std::cerr << "Sample Fmt from codec: " << codecContext->sample_fmt << std::endl;
-        swr_free(&swrContext);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return false;
-    }
-    std::cout << "Input sample format: " << av_get_sample_fmt_name(codecContext->sample_fmt) 
-              << " (ID: " << codecContext->sample_fmt << ")" << std::endl;
+        if (!videoOk) {
+            std::cerr << "Failed to process video frames" << std::endl;
+            return false;
+        }
 
-    av_opt_set_sample_fmt(swrContext, "in_sample_fmt", codecContext->sample_fmt, 0);
-    av_opt_set_sample_fmt(swrContext, "out_sample_fmt", AV_SAMPLE_FMT_FLTP, 0);
+        if (!readOk) {
+            std::cerr << "Failed to read input video" << std::endl;
+            return false;
+        }
 
-    if (swr_init(swrContext) < 0) {
-        std::cerr << "Failed to initialize resampler" << std::endl;
-        swr_free(&swrContext);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
-        return false;
-    }
+        if (!muxer.finish()) {
+            std::cerr << "Failed to finalize output file: " << outputPath << std::endl;
+            return false;
+        }
 
-    AVPacket packet;
-    AVFrame* frame = av_frame_alloc();
-    if (!frame) {
-        std::cerr << "Failed to allocate AVFrame" << std::endl;
-        swr_free(&swrContext);
-        avcodec_free_context(&codecContext);
-        avformat_close_input(&formatContext);
+        reportStageTimes(demuxer, muxer, inputPath, secondsSince(wallStart), processCpuSeconds() - cpuStart);
+        std::cout << "Output written: " << outputPath << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error processing video: " << e.what() << std::endl;
         return false;
     }
-    std::vector<std::vector<float>> channelData(channels);
-
-    av_seek_frame(formatContext, audioStreamIndex, 0, AVSEEK_FLAG_BACKWARD);
-    avcodec_flush_buffers(codecContext);
-
-    while (av_read_frame(formatContext, &packet) >= 0) {
-        if (packet.stream_index == audioStreamIndex) {
-            if (avcodec_send_packet(codecContext, &packet) >= 0) {
-                while (avcodec_receive_frame(codecContext, frame) >= 0) {
-                    uint8_t** output;
-                    int out_samples = frame->nb_samples;
-                    int alloc_ret = av_samples_alloc_array_and_samples(&output, nullptr, channels, out_samples, AV_SAMPLE_FMT_FLTP, 0);
-                    if (alloc_ret < 0) {
-                        std::cerr << "Failed to allocate sample buffer" << std::endl;
-                        continue;
-                    }
+}
 
-                    out_samples = swr_convert(swrContext, output, out_samples,
-                                          (const uint8_t**)frame->extended_data, frame->nb_samples);
+bool VideoProcessor::processAudioBranch(MediaDemuxer& demuxer, AudioPacketQueue& packets, MediaMuxer& muxer) {
+    auto onBlock = [&](const float* const* channelData, int numSamples) {
+        processAudio(channelData, numSamples);
+        return writeProcessedAudio(muxer);
+    };
 
-                    if (out_samples > 0) {
-                        for (int ch = 0; ch < channels; ch++) {
-                            float* data = (float*)output[ch];
-                            channelData[ch].insert(channelData[ch].end(), data, data + out_samples);
-                        }
-                    }
-
-                    if (output) {
-                        av_freep(&output[0]);
-                        av_freep(&output);
-                    }
-                }
-            }
+    PacketPtr packet;
+    while (packets.pop(packet)) {
+        if (!demuxer.decodeAudio(packet.get(), onBlock)) {
+            return false;
         }
-        av_packet_unref(&packet);
-    }
-
-    size_t totalSamples = 0;
-    for (const auto& ch : channelData) {
-        totalSamples = std::max(totalSamples, ch.size());
     }
 
-    audioData.resize(totalSamples * channels);
-    for (size_t i = 0; i < totalSamples; i++) {
-        for (int ch = 0; ch < channels; ch++) {
-            if (i < channelData[ch].size()) {
-                audioData[i * channels + ch] = channelData[ch][i];
-            } else {
-                audioData[i * channels + ch] = 0.0f;
-            }
-        }
+    // Drain the decoder, then the filter tails
+    if (!demuxer.decodeAudio(nullptr, onBlock)) {
+        return false;
     }
-
-    av_frame_free(&frame);
-    swr_free(&swrContext);
-    avcodec_free_context(&codecContext);
-    avformat_close_input(&formatContext);
-
-    return true;
+    flushAudioProcessing();
+    return writeProcessedAudio(muxer);
 }
 
-bool VideoProcessor::processAudio(std::vector<float>& audioData, int sampleRate, int channels) {
-    if (audioData.empty() || sampleRate <= 0 || channels <= 0) {
+bool VideoProcessor::beginAudioProcessing(int sampleRate, int channels) {
+    if (sampleRate <= 0 || channels <= 0) {
         std::cerr << "Invalid audio data or parameters" << std::endl;
         return false;
     }
 
-    m_audioProcessor = std::make_unique<AudioProcessor>(
-        sampleRate, m_lowCutoff, m_highCutoff, m_noiseReduction);
+    // Each channel is an independent stream with its own filter state, so
+    // channels can run on separate threads without sharing anything. Cores
+    // left over when there are fewer channels than cores (mono, stereo)
+    // split each channel's spectral subtraction into time slices.
+    int hardwareThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int sliceThreads = std::max(1, hardwareThreads / channels);
 
-    if (channels == 1) {
-        audioData = m_audioProcessor->process(audioData);
-    } else if (channels >= 2) {
-        std::vector<std::vector<float>> channelData(channels);
-        for (size_t i = 0; i < channelData.size(); i++) {
-            channelData[i].resize(audioData.size() / channels);
-        }
+    m_channelProcessors.clear();
+    for (int ch = 0; ch < channels; ch++) {
+        m_channelProcessors.push_back(std::make_unique<AudioProcessor>(
+            sampleRate, m_lowCutoff, m_highCutoff, m_noiseReduction, sliceThreads));
+    }
+    m_channelOutput.assign(channels, std::vector<float>());
+    m_channelOutputPointers.assign(channels, nullptr);
 
-        for (size_t i = 0; i < audioData.size() / channels; i++) {
-            for (int ch = 0; ch < channels; ch++) {
-                channelData[ch][i] = audioData[i * channels + ch];
-            }
-        }
+    m_audioPool = std::make_unique<ThreadPool>(std::min(channels, hardwareThreads));
 
-        for (int ch = 0; ch < channels; ch++) {
-            channelData[ch] = m_audioProcessor->process(channelData[ch]);
-        }
+    return true;
+}
 
-        size_t maxSamples = 0;
-        for (const auto& ch : channelData) {
-            maxSamples = std::max(maxSamples, ch.size());
-        }
+void VideoProcessor::processAudio(const float* const* channelData, int numSamples) {
+    runChannelWorkers([&](size_t ch, std::vector<float>& output) {
+        m_channelProcessors[ch]->pushBlock(channelData[ch], numSamples, output);
+    });
+}
 
-        audioData.resize(maxSamples * channels);
-        for (size_t i = 0; i < maxSamples; i++) {
-            for (int ch = 0; ch < channels; ch++) {
-                if (i < channelData[ch].size()) {
-                    audioData[i * channels + ch] = channelData[ch][i];
-                } else {
-                    audioData[i * channels + ch] = 0.0f;
-                }
-            }
-        }
-    }
+void VideoProcessor::flushAudioProcessing() {
+    runChannelWorkers([&](size_t ch, std::vector<float>& output) {
+        m_channelProcessors[ch]->flush(output);
+    });
+}
 
-    return true;
+void VideoProcessor::runChannelWorkers(const std::function<void(size_t channel, std::vector<float>& output)>& step) {
+    m_audioPool->parallelFor(m_channelProcessors.size(), [&](size_t ch) {
+        std::vector<float>& output = m_channelOutput[ch];
+        output.clear();
+        step(ch, output);
+    });
 }
 
-cv::Mat VideoProcessor::denoiseFrame(const cv::Mat& frame) {
+void VideoProcessor::denoiseFrame(const cv::Mat& frame, cv::Mat& denoisedFrame) {
     if (m_lastFrameWidth != frame.cols || m_lastFrameHeight != frame.rows) {
         m_lastFrameWidth = frame.cols;
         m_lastFrameHeight = frame.rows;
         m_videoDenoiser->initialize(m_lastFrameWidth, m_lastFrameHeight);
     }
 
-    return m_videoDenoiser->denoise(frame);
+    m_videoDenoiser->denoise(frame, denoisedFrame);
 }
 
-void VideoProcessor::applyAdditionalVideoEnhancements(cv::Mat& frame) {
-    double alpha = 1.2;
-    int beta = 5;
-    frame.convertTo(frame, -1, alpha, beta);
-}
+bool VideoProcessor::writeProcessedAudio(MediaMuxer& muxer) {
+    // All channels see the same block sizes, so they emit in lockstep. The
+    // AAC encoder takes planar input, so channels are never interleaved.
+    if (m_channelOutput.empty() || m_channelOutput[0].empty()) {
+        return true;
+    }
 
-void writeWavHeader(std::ofstream& file, int sampleRate, int numChannels, int numSamples, int bitsPerSample) {
-    int64_t dataSize = static_cast<int64_t>(numSamples) * numChannels * (bitsPerSample / 8);
-    if (dataSize > INT32_MAX - 36) {
-        std::cerr << "Warning: Audio data too large for standard WAV format. Output may be truncated." << std::endl;
-        dataSize = INT32_MAX - 36;
+    for (size_t ch = 0; ch < m_channelOutput.size(); ch++) {
+        m_channelOutputPointers[ch] = m_channelOutput[ch].data();
     }
+    return muxer.writeAudio(m_channelOutputPointers.data(), static_cast<int>(m_channelOutput[0].size()));
+}
 
-    file.write("RIFF", 4);
-    int32_t chunkSize = static_cast<int32_t>(36 + dataSize);
-    file.write(reinterpret_cast<const char*>(&chunkSize), 4);
-    file.write("WAVE", 4);
-    file.write("fmt ", 4);
-    int32_t subchunk1Size = 16;
-    file.write(reinterpret_cast<const char*>(&subchunk1Size), 4);
-    int16_t audioFormat = (bitsPerSample == 32) ? 3 : 1;
-    file.write(reinterpret_cast<const char*>(&audioFormat), 2);
-    int16_t channels = static_cast<int16_t>(numChannels);
-    file.write(reinterpret_cast<const char*>(&channels), 2);
-    int32_t sr = sampleRate;
-    file.write(reinterpret_cast<const char*>(&sr), 4);
-    int32_t byteRate = sampleRate * numChannels * (bitsPerSample / 8);
-    file.write(reinterpret_cast<const char*>(&byteRate), 4);
-    int16_t blockAlign = numChannels * (bitsPerSample / 8);
-    file.write(reinterpret_cast<const char*>(&blockAlign), 2);
-    int16_t bps = static_cast<int16_t>(bitsPerSample);
-    file.write(reinterpret_cast<const char*>(&bps), 2);
-    file.write("data", 4);
-    int32_t subchunk2Size = static_cast<int32_t>(dataSize);
-    file.write(reinterpret_cast<const char*>(&subchunk2Size), 4);
+bool VideoProcessor::processVideoFrames(FrameQueue& frames, FramePool& framePool, MediaMuxer& muxer,
+                                        int totalFrames, const VideoDenoiserOptions& denoiserOptions) {
+    std::string denoiserType = denoiserOptions.backend == DenoiserBackend::Temporal ? "CPU temporal" : "CPU";
+    if (denoiserOptions.preview) {
+        denoiserType += " preview";
+    }
+    if (denoiserOptions.planarYuv) {
+        denoiserType += " planar YUV";
+    }
+    if (denoiserOptions.skipThreshold >= 0) {
+        denoiserType += " change-skipping";
+    }
+    std::cout << "Using " << denoiserType << " implementation for video denoising";
+
+    // A temporal or change-skipping denoiser needs every frame in order, so
+    // frame-level workers cannot split the stream; it parallelizes within each
+    // frame instead.
+    bool pipelined = m_numThreads > 1 && !m_videoDenoiser->isTemporal();
+    if (pipelined) {
+        std::cout << " (" << m_numThreads << " worker threads)";
+    } else if (m_numThreads > 1) {
+        std::cout << " (frames in order, threaded within each frame)";
+    }
+    std::cout << std::endl;
+
+    m_skipStats = SkipStats();
+    m_denoiseTime = StageTime();
+    bool ok = pipelined
+        ? runPipelinedFrameLoop(frames, framePool, muxer, totalFrames, denoiserOptions)
+        : runSequentialFrameLoop(frames, framePool, muxer, totalFrames);
+    reportSkipStats();
+    return ok;
 }
 
-bool VideoProcessor::saveProcessedAudioToWav(const std::string& wavPath, const std::vector<float>& audioData,
-                                           int audioSampleRate, int audioChannels) {
-    if (audioData.empty()) {
-        std::cerr << "Audio data is empty, cannot save WAV file." << std::endl;
-        return false;
+void VideoProcessor::reportSkipStats() const {
+    if (m_skipStats.frames == 0) {
+        return;
     }
+    std::cout << "Change detection: skipped " << m_skipStats.skippedFrames << "/" << m_skipStats.frames
+              << " frames, " << m_skipStats.skippedTiles << "/" << m_skipStats.tiles << " tiles ("
+              << (100.0 * m_skipStats.skippedTiles / m_skipStats.tiles) << "%)" << std::endl;
+}
 
-    std::ofstream outFile(wavPath, std::ios::binary);
-    if (!outFile.is_open()) {
-        std::cerr << "Failed to open temporary WAV file for writing: " << wavPath << std::endl;
-        return false;
+void VideoProcessor::reportStageTimes(const MediaDemuxer& demuxer, const MediaMuxer& muxer,
+                                      const std::string& inputPath, double wallSeconds, double cpuSeconds) {
+    // Brightness/contrast is fused into the denoiser's output pass, so it is part of the denoise time
+    PipelineStats stats;
+    demuxer.collectStageTimes(stats);
+    muxer.collectStageTimes(stats);
+    for (const auto& processor : m_channelProcessors) {
+        processor->collectStageTimes(stats);
+    }
+    stats.add(PipelineStage::Denoise, m_denoiseTime);
+    stats.setTotals(wallSeconds, cpuSeconds);
+    stats.print(std::cout);
+    std::cout << "Process CPU time: " << cpuSeconds << " s over " << wallSeconds << " s wall" << std::endl;
+
+    if (m_statsPath.empty()) {
+        return;
+    }
+    stats.setInfo("input", inputPath);
+    stats.setInfo("video_codec", m_encoderSettings.codec);
+    stats.setInfo("denoiser", m_denoiserOptions.backend == DenoiserBackend::Temporal ? "temporal" : "spatial");
+    stats.setInfo("denoise_strength", std::to_string(m_videoDenoiseStrength));
+    stats.setInfo("threads", std::to_string(m_numThreads));
+    stats.setInfo("resolution", std::to_string(demuxer.width()) + "x" + std::to_string(demuxer.height()));
+    if (stats.writeJson(m_statsPath)) {
+        std::cout << "Stage report written: " << m_statsPath << std::endl;
     }
+}
 
-    int bitsPerSample = 32;
-    int numSamples = audioData.size() / audioChannels;
-
-    writeWavHeader(outFile, audioSampleRate, audioChannels, numSamples, bitsPerSample);
-
-    outFile.write(reinterpret_cast<const char*>(audioData.data()), audioData.size() * sizeof(float));
-
-    if (!outFile.good()) {
-        std::cerr << "Error writing to WAV file: " << wavPath << std::endl;
-        outFile.close();
-        return false;
+void VideoProcessor::reportFrameProgress(int frameCount, int totalFrames) {
+    if (totalFrames > 0 && (frameCount % 100 == 0 || frameCount == totalFrames)) {
+        std::cout << "Processed " << frameCount << "/" << totalFrames << " frames ("
+                  << (100.0 * frameCount / totalFrames) << "%)" << std::endl;
     }
-
-    outFile.close();
-    std::cout << "Processed audio saved to temporary WAV file: " << wavPath << std::endl;
-    return true;
 }
 
-static int runFFmpegMux(const std::string& tempVideo, const std::string& tempAudio,
-                        const std::string& output, const std::string& logPath) {
-    pid_t pid = fork();
-    if (pid < 0) {
-        std::cerr << "Failed to fork process for FFmpeg" << std::endl;
-        return -1;
-    }
+bool VideoProcessor::runSequentialFrameLoop(FrameQueue& frames, FramePool& framePool, MediaMuxer& muxer,
+                                            int totalFrames) {
+    DecodedFrame item;
+    cv::Mat denoisedFrame;   // The encoder copies each frame, so one output buffer serves the whole stream
+    int frameCount = 0;
 
-    if (pid == 0) {
-        int logFd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (logFd >= 0) {
-            dup2(logFd, STDERR_FILENO);
-            close(logFd);
+    while (frames.pop(item)) {
+        {
+            StageTimer timer(&m_denoiseTime, 1);
+            denoiseFrame(item.image, denoisedFrame);
+        }
+        framePool.recycle(item.image);
+        if (!muxer.writeVideoFrame(denoisedFrame)) {
+            return false;
+        }
+        if (m_recordLatencies) {
+            m_frameLatencies.push_back(monotonicSeconds() - item.decodedAt);
         }
 
-        execlp("ffmpeg", "ffmpeg", "-y",
-               "-i", tempVideo.c_str(),
-               "-i", tempAudio.c_str(),
-               "-c:v", "copy", "-c:a", "aac",
-               "-strict", "experimental",
-               "-shortest", output.c_str(),
-               (char*)nullptr);
-
-        _exit(127);
+        frameCount++;
+        reportFrameProgress(frameCount, totalFrames);
     }
 
-    int status = 0;
-    waitpid(pid, &status, 0);
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-    }
-    return -1;
+    m_skipStats = m_videoDenoiser->skipStats();
+    return true;
 }
 
-bool VideoProcessor::processVideoFrames(const std::string& inputPath, const std::string& outputPath,
-                                      const std::vector<float>& processedAudio, int audioSampleRate, int audioChannels) {
-    cv::VideoCapture inputVideo(inputPath);
-    if (!inputVideo.isOpened()) {
-        std::cerr << "Could not open input video: " << inputPath << std::endl;
-        return false;
-    }
-
-    int width = static_cast<int>(inputVideo.get(cv::CAP_PROP_FRAME_WIDTH));
-    int height = static_cast<int>(inputVideo.get(cv::CAP_PROP_FRAME_HEIGHT));
-    double fps = inputVideo.get(cv::CAP_PROP_FPS);
-    int totalFrames = static_cast<int>(inputVideo.get(cv::CAP_PROP_FRAME_COUNT));
-
-    if (fps <= 0) {
-        std::cerr << "Error: Invalid FPS (" << fps << ") from input video." << std::endl;
-        inputVideo.release();
-        return false;
-    }
+bool VideoProcessor::runPipelinedFrameLoop(FrameQueue& decodedFrames, FramePool& framePool, MediaMuxer& muxer,
+                                           int totalFrames, const VideoDenoiserOptions& denoiserOptions) {
+    // Queue depths are tied to the worker count so memory stays bounded
+    // regardless of clip length.
+    const size_t queueDepth = static_cast<size_t>(m_numThreads) * 2;
+    ReorderBuffer<DecodedFrame> finishedFrames(queueDepth);
+
+    std::atomic<bool> failed(false);
+    std::atomic<int> activeWorkers(m_numThreads);
+    std::mutex errorMutex;
+    std::string errorMessage;
+    std::mutex statsMutex;
+
+    auto abortPipeline = [&](const std::string& message) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (errorMessage.empty()) {
+                errorMessage = message;
+            }
+        }
+        failed = true;
+        decodedFrames.close();
+        finishedFrames.close();
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(m_numThreads);
+    for (int w = 0; w < m_numThreads; w++) {
+        workers.emplace_back([&]() {
+            try {
+                std::unique_ptr<VideoDenoiser> denoiser = createVideoDenoiser(m_videoDenoiseStrength, denoiserOptions);
+                int lastWidth = 0;
+                int lastHeight = 0;
+                StageTime denoiseTime;
+
+                DecodedFrame item;
+                while (decodedFrames.pop(item)) {
+                    if (lastWidth != item.image.cols || lastHeight != item.image.rows) {
+                        lastWidth = item.image.cols;
+                        lastHeight = item.image.rows;
+                        denoiser->initialize(lastWidth, lastHeight);
+                    }
 
-    std::string finalOutputPath = outputPath;
-    std::string tempVideoFile = finalOutputPath + ".tmp_vid.mp4";
+                    cv::Mat denoisedFrame = framePool.acquire(item.image.rows, item.image.cols, item.image.type());
+                    {
+                        StageTimer timer(&denoiseTime, 1);
+                        denoiser->denoise(item.image, denoisedFrame);
+                    }
+                    framePool.recycle(item.image);
+                    size_t index = item.index;
+                    if (!finishedFrames.push(index, {index, std::move(denoisedFrame), item.decodedAt})) {
+                        break;
+                    }
+                }
 
-    cv::VideoWriter outputVideo;
-    int fourcc = cv::VideoWriter::fourcc('a', 'v', 'c', '1');
-    outputVideo.open(tempVideoFile, fourcc, fps, cv::Size(width, height), true);
+                std::lock_guard<std::mutex> lock(statsMutex);
+                m_skipStats += denoiser->skipStats();
+                m_denoiseTime += denoiseTime;
+            } catch (const std::exception& e) {
+                abortPipeline(std::string("Denoise worker failed: ") + e.what());
+            }
 
-    if (!outputVideo.isOpened()) {
-        std::cerr << "Could not create temporary output video file: " << tempVideoFile << std::endl;
-        return false;
+            if (--activeWorkers == 0) {
+                finishedFrames.close();
+            }
+        });
     }
 
-    cv::Mat frame;
     int frameCount = 0;
-
-    std::string denoiserType = "CPU";
-    std::cout << "Using " << denoiserType << " implementation for video denoising" << std::endl;
-
-    while (inputVideo.read(frame)) {
-        cv::Mat denoisedFrame = denoiseFrame(frame);
-        applyAdditionalVideoEnhancements(denoisedFrame);
-        outputVideo.write(denoisedFrame);
+    DecodedFrame finished;
+    while (finishedFrames.pop(finished)) {
+        if (!muxer.writeVideoFrame(finished.image)) {
+            abortPipeline("Failed to encode video frame");
+            break;
+        }
+        framePool.recycle(finished.image);
+        if (m_recordLatencies) {
+            m_frameLatencies.push_back(monotonicSeconds() - finished.decodedAt);
+        }
 
         frameCount++;
-        if (totalFrames > 0 && (frameCount % 100 == 0 || frameCount == totalFrames)) {
-            std::cout << "Processed " << frameCount << "/" << totalFrames << " frames ("
-                      << (100.0 * frameCount / totalFrames) << "%)" << std::endl;
-        }
+        reportFrameProgress(frameCount, totalFrames);
     }
 
-    inputVideo.release();
-    outputVideo.release();
-
-    std::string tempAudioPath = finalOutputPath + ".tmp_audio.wav";
-    if (!saveProcessedAudioToWav(tempAudioPath, processedAudio, audioSampleRate, audioChannels)) {
-        std::cerr << "Failed to save processed audio to temporary WAV file. Muxing aborted." << std::endl;
-        return false;
+    for (auto& worker : workers) {
+        worker.join();
     }
 
-    std::string logPath = finalOutputPath + ".ffmpeg_log.txt";
-    std::cout << "Muxing audio and video with FFmpeg..." << std::endl;
-    int ret = runFFmpegMux(tempVideoFile, tempAudioPath, finalOutputPath, logPath);
-
-    if (ret == 0) {
-        std::cout << "Muxing successful. Final output: " << finalOutputPath << std::endl;
-
-        if (std::remove(tempVideoFile.c_str()) != 0) {
-            std::perror(("Error deleting temporary video file: " + tempVideoFile).c_str());
-        }
-        if (std::remove(tempAudioPath.c_str()) != 0) {
-            std::perror(("Error deleting temporary audio file: " + tempAudioPath).c_str());
-        }
-    } else {
-        std::cerr << "FFmpeg muxing failed. Return code: " << ret << std::endl;
-        std::cerr << "Check " << logPath << " for details." << std::endl;
-        std::cerr << "Temporary files preserved for debugging:" << std::endl;
-        std::cerr << "  Video: " << tempVideoFile << std::endl;
-        std::cerr << "  Audio: " << tempAudioPath << std::endl;
+    if (failed) {
+        std::cerr << errorMessage << std::endl;
         return false;
     }
 
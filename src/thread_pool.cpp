@@ -0,0 +1,89 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int numThreads) {
+    for (int i = 1; i < numThreads; i++) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_startLoop.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t count, TaskInvoker invoke, const void* context) {
+    if (count == 0) {
+        return;
+    }
+
+    // Small loops, and pools without workers, are not worth waking anyone for
+    if (count == 1 || m_workers.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            invoke(context, i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> loopLock(m_loopMutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_invoke = invoke;
+    m_context = context;
+    m_count = count;
+    m_nextIndex = 0;
+    m_pending = count;
+    m_error = nullptr;
+    m_generation++;
+    m_startLoop.notify_all();
+
+    runIterations(lock);
+    m_loopDone.wait(lock, [this] { return m_pending == 0; });
+    m_invoke = nullptr;
+    m_context = nullptr;
+
+    if (m_error) {
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    size_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_startLoop.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+        if (m_stopping) {
+            return;
+        }
+        seenGeneration = m_generation;
+        runIterations(lock);
+    }
+}
+
+void ThreadPool::runIterations(std::unique_lock<std::mutex>& lock) {
+    while (m_invoke && m_nextIndex < m_count) {
+        size_t index = m_nextIndex++;
+        TaskInvoker invoke = m_invoke;
+        const void* context = m_context;
+        lock.unlock();
+        try {
+            invoke(context, index);
+        } catch (...) {
+            lock.lock();
+            if (!m_error) {
+                m_error = std::current_exception();
+            }
+            lock.unlock();
+        }
+        lock.lock();
+        if (--m_pending == 0) {
+            m_loopDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,1033 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "frame_pool.h"
+#include "process.h"
+#include "video_denoise.h"
+
+/**
+ * Synthetic static-camera clip: a fixed background with one moving object
+ */
+class SyntheticClip {
+public:
+    /**
+     * Constructor
+     * @param width Frame width
+     * @param height Frame height
+     * @param noiseSigma Standard deviation of the added Gaussian noise
+     */
+    SyntheticClip(int width, int height, double noiseSigma)
+        : m_width(width), m_height(height), m_noiseSigma(noiseSigma) {
+        m_background = cv::Mat(height, width, CV_8UC3);
+        for (int y = 0; y < height; y++) {
+            cv::Vec3b* row = m_background.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < width; x++) {
+                row[x][0] = static_cast<uchar>(255 * x / width);
+                row[x][1] = static_cast<uchar>(255 * y / height);
+                row[x][2] = static_cast<uchar>(128 + 64 * ((x / 64 + y / 64) % 2));
+            }
+        }
+        cv::circle(m_background, cv::Point(width / 3, height / 2), height / 5, cv::Scalar(40, 200, 220), cv::FILLED);
+        cv::rectangle(m_background, cv::Rect(width / 2, height / 4, width / 4, height / 3),
+                      cv::Scalar(230, 60, 30), cv::FILLED);
+    }
+
+    /**
+     * Renders a frame; the same index always gives the same clean and noisy images
+     * @param index Frame index
+     * @param clean Receives the noise-free frame
+     * @param noisy Receives the frame with noise added
+     */
+    void render(int index, cv::Mat& clean, cv::Mat& noisy) const {
+        m_background.copyTo(clean);
+        int size = m_height / 6;
+        int x = (index * 8) % std::max(1, m_width - size);
+        cv::rectangle(clean, cv::Rect(x, m_height - 2 * size, size, size), cv::Scalar(250, 250, 250), cv::FILLED);
+
+        cv::RNG rng(0x5eed + index);
+        cv::Mat noise(m_height, m_width, CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(m_noiseSigma));
+        cv::Mat sum;
+        clean.convertTo(sum, CV_16SC3);
+        sum += noise;
+        sum.convertTo(noisy, CV_8UC3);
+    }
+
+private:
+    int m_width;
+    int m_height;
+    double m_noiseSigma;
+    cv::Mat m_background;
+};
+
+/**
+ * Runs a denoiser over the clip
+ * @param denoiser Denoiser under test
+ * @param clip Input clip
+ * @param frames Number of frames
+ * @param msPerFrame Receives the mean denoise time per frame
+ * @param inputPsnr Receives the mean PSNR of the noisy input against the clean frames
+ * @param outputPsnr Receives the mean PSNR of the denoised output against the clean frames
+ */
+static void runDenoiser(VideoDenoiser& denoiser, const SyntheticClip& clip, int frames,
+                        double& msPerFrame, double& inputPsnr, double& outputPsnr) {
+    cv::Mat clean;
+    cv::Mat noisy;
+    cv::Mat output;
+    double seconds = 0.0;
+    inputPsnr = 0.0;
+    outputPsnr = 0.0;
+
+    for (int i = 0; i < frames; i++) {
+        clip.render(i, clean, noisy);
+        if (i == 0) {
+            denoiser.initialize(noisy.cols, noisy.rows);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        denoiser.denoise(noisy, output);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        inputPsnr += cv::PSNR(noisy, clean);
+        outputPsnr += cv::PSNR(output, clean);
+    }
+
+    msPerFrame = seconds * 1000.0 / frames;
+    inputPsnr /= frames;
+    outputPsnr /= frames;
+}
+
+static int runDenoiserBench(int width, int height, int frames, float strength, double noiseSigma,
+                            const std::vector<int>& windows) {
+    SyntheticClip clip(width, height, noiseSigma);
+
+    std::cout << "Denoising " << frames << " frames at " << width << "x" << height
+              << ", strength " << strength << ", noise sigma " << noiseSigma << std::endl;
+    std::cout << std::setw(14) << "backend" << std::setw(12) << "ms/frame" << std::setw(10) << "fps"
+              << std::setw(12) << "PSNR in" << std::setw(12) << "PSNR out" << std::endl;
+
+    auto report = [&](const std::string& name, VideoDenoiser& denoiser) {
+        double msPerFrame = 0.0;
+        double inputPsnr = 0.0;
+        double outputPsnr = 0.0;
+        runDenoiser(denoiser, clip, frames, msPerFrame, inputPsnr, outputPsnr);
+        std::cout << std::setw(14) << name
+                  << std::setw(12) << std::fixed << std::setprecision(2) << msPerFrame
+                  << std::setw(10) << std::setprecision(1) << 1000.0 / msPerFrame
+                  << std::setw(12) << std::setprecision(2) << inputPsnr
+                  << std::setw(12) << outputPsnr << std::endl;
+    };
+
+    // PSNR is measured against the clean clip, so the brightness/contrast stage stays off
+    VideoDenoiserOptions options;
+    options.contrast = 1.0;
+    options.brightness = 0.0;
+
+    std::unique_ptr<VideoDenoiser> spatial = createVideoDenoiser(strength, options);
+    report("spatial", *spatial);
+
+    for (int window : windows) {
+        options.backend = DenoiserBackend::Temporal;
+        options.temporalWindow = window;
+        std::unique_ptr<VideoDenoiser> temporal = createVideoDenoiser(strength, options);
+        report("temporal-" + std::to_string(window), *temporal);
+    }
+    return 0;
+}
+
+/**
+ * Stand-in for one pass of the frame loop: decode into a buffer, denoise, enhance, encode
+ * @param denoiser Denoiser to run
+ * @param source Frame to "decode"
+ * @param pool Pool to take buffers from, or nullptr to allocate fresh ones like the old loop
+ * @return Checksum of the output, so the work cannot be optimized away
+ */
+static int simulateFrame(VideoDenoiser& denoiser, const cv::Mat& source, FramePool* pool) {
+    cv::Mat decoded = pool ? pool->acquire(source.rows, source.cols, source.type())
+                           : cv::Mat(source.rows, source.cols, source.type());
+    source.copyTo(decoded);
+
+    cv::Mat denoised;
+    if (pool) {
+        denoised = pool->acquire(source.rows, source.cols, source.type());
+    }
+    denoiser.denoise(decoded, denoised);
+    int checksum = denoised.ptr<uchar>(denoised.rows / 2)[0];
+
+    if (pool) {
+        pool->recycle(decoded);
+        pool->recycle(denoised);
+    }
+    return checksum;
+}
+
+static int runPoolBench(int width, int height, int frames, float strength, double noiseSigma) {
+    SyntheticClip clip(width, height, noiseSigma);
+    cv::Mat clean;
+    cv::Mat noisy;
+    clip.render(0, clean, noisy);
+
+    // The temporal backend is cheap enough that buffer handling shows up in the totals
+    VideoDenoiserOptions options;
+    options.backend = DenoiserBackend::Temporal;
+
+    std::cout << "Frame loop buffers, " << frames << " frames at " << width << "x" << height << std::endl;
+    std::cout << std::setw(14) << "buffers" << std::setw(12) << "ms/frame" << std::setw(14) << "allocations"
+              << std::endl;
+
+    volatile int sink = 0;
+    for (int pooled = 0; pooled < 2; pooled++) {
+        std::unique_ptr<VideoDenoiser> denoiser = createVideoDenoiser(strength, options);
+        denoiser->initialize(width, height);
+        FramePool pool(4);
+        FramePool* framePool = pooled ? &pool : nullptr;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            sink = sink + simulateFrame(*denoiser, noisy, framePool);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::setw(14) << (pooled ? "pooled" : "fresh")
+                  << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1000.0 / frames
+                  << std::setw(14) << (pooled ? std::to_string(pool.allocations()) : std::to_string(frames * 2))
+                  << std::endl;
+    }
+    return 0;
+}
+
+static int runEnhanceBench(int width, int height, int frames, float strength, double noiseSigma) {
+    SyntheticClip clip(width, height, noiseSigma);
+    cv::Mat clean;
+    cv::Mat noisy;
+
+    std::cout << "Denoise + brightness/contrast, " << frames << " frames at " << width << "x" << height
+              << ", strength " << strength << std::endl;
+    std::cout << std::setw(12) << "backend" << std::setw(14) << "separate ms" << std::setw(12) << "fused ms"
+              << std::setw(12) << "max diff" << std::endl;
+
+    for (DenoiserBackend backend : {DenoiserBackend::Spatial, DenoiserBackend::Temporal}) {
+        VideoDenoiserOptions plain;
+        plain.backend = backend;
+        plain.contrast = 1.0;
+        plain.brightness = 0.0;
+        VideoDenoiserOptions fused = plain;
+        fused.contrast = 1.2;
+        fused.brightness = 5.0;
+
+        std::unique_ptr<VideoDenoiser> separateDenoiser = createVideoDenoiser(strength, plain);
+        std::unique_ptr<VideoDenoiser> fusedDenoiser = createVideoDenoiser(strength, fused);
+        cv::Mat separateOutput;
+        cv::Mat fusedOutput;
+        double separateSeconds = 0.0;
+        double fusedSeconds = 0.0;
+        double maxDiff = 0.0;
+
+        for (int i = 0; i < frames; i++) {
+            clip.render(i, clean, noisy);
+
+            // The old loop: denoise, then a second full-frame pass
+            auto start = std::chrono::steady_clock::now();
+            separateDenoiser->denoise(noisy, separateOutput);
+            separateOutput.convertTo(separateOutput, -1, fused.contrast, fused.brightness);
+            separateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            fusedDenoiser->denoise(noisy, fusedOutput);
+            fusedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            maxDiff = std::max(maxDiff, cv::norm(separateOutput, fusedOutput, cv::NORM_INF));
+        }
+
+        std::cout << std::setw(12) << (backend == DenoiserBackend::Temporal ? "temporal" : "spatial")
+                  << std::setw(14) << std::fixed << std::setprecision(2) << separateSeconds * 1000.0 / frames
+                  << std::setw(12) << fusedSeconds * 1000.0 / frames
+                  << std::setw(12) << std::setprecision(0) << maxDiff << std::endl;
+    }
+    return 0;
+}
+
+static int runTileBench(int frames, float strength, double noiseSigma, const std::vector<int>& tileSizes) {
+    const cv::Size resolutions[] = {cv::Size(1920, 1080), cv::Size(3840, 2160), cv::Size(7680, 4320)};
+
+    std::cout << "Whole-frame vs tiled spatial denoising, " << frames << " frames per size, strength "
+              << strength << std::endl;
+    std::cout << std::setw(12) << "frame" << std::setw(8) << "tile" << std::setw(12) << "ms/frame"
+              << std::setw(10) << "speedup" << std::setw(12) << "max diff" << std::endl;
+
+    std::vector<int> sizes = {0};
+    sizes.insert(sizes.end(), tileSizes.begin(), tileSizes.end());
+
+    for (const cv::Size& resolution : resolutions) {
+        SyntheticClip clip(resolution.width, resolution.height, noiseSigma);
+        std::string frameName = std::to_string(resolution.width) + "x" + std::to_string(resolution.height);
+
+        std::vector<std::unique_ptr<VideoDenoiser>> denoisers;
+        for (int tileSize : sizes) {
+            VideoDenoiserOptions options;
+            options.tileSize = tileSize;
+            denoisers.push_back(createVideoDenoiser(strength, options));
+        }
+
+        // The spatial backend keeps no state between frames, so each frame runs
+        // through every tile size in turn and is compared with the whole-frame output
+        std::vector<double> seconds(sizes.size(), 0.0);
+        std::vector<double> maxDiff(sizes.size(), 0.0);
+        cv::Mat clean;
+        cv::Mat noisy;
+        cv::Mat reference;
+        cv::Mat output;
+        for (int i = 0; i < frames; i++) {
+            clip.render(i, clean, noisy);
+            for (size_t k = 0; k < sizes.size(); k++) {
+                cv::Mat& target = (k == 0) ? reference : output;
+                auto start = std::chrono::steady_clock::now();
+                denoisers[k]->denoise(noisy, target);
+                seconds[k] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (k > 0) {
+                    maxDiff[k] = std::max(maxDiff[k], cv::norm(output, reference, cv::NORM_INF));
+                }
+            }
+        }
+
+        for (size_t k = 0; k < sizes.size(); k++) {
+            std::cout << std::setw(12) << frameName
+                      << std::setw(8) << (sizes[k] == 0 ? std::string("whole") : std::to_string(sizes[k]))
+                      << std::setw(12) << std::fixed << std::setprecision(2) << seconds[k] * 1000.0 / frames
+                      << std::setw(10) << seconds[0] / seconds[k]
+                      << std::setw(12) << std::setprecision(0) << maxDiff[k] << std::endl;
+        }
+    }
+    return 0;
+}
+
+static int runPreviewBench(int width, int height, int frames, float strength, double noiseSigma,
+                           const std::vector<int>& scales) {
+    SyntheticClip clip(width, height, noiseSigma);
+
+    std::cout << "Full-resolution vs preview denoising, " << frames << " frames at " << width << "x" << height
+              << ", strength " << strength << std::endl;
+    std::cout << std::setw(10) << "mode" << std::setw(12) << "ms/frame" << std::setw(10) << "speedup"
+              << std::setw(12) << "PSNR clean" << std::setw(12) << "PSNR full" << std::endl;
+
+    // Quality is compared without the brightness/contrast stage
+    VideoDenoiserOptions options;
+    options.contrast = 1.0;
+    options.brightness = 0.0;
+
+    std::vector<std::unique_ptr<VideoDenoiser>> denoisers;
+    denoisers.push_back(createVideoDenoiser(strength, options));
+    for (int scale : scales) {
+        options.preview = true;
+        options.previewScale = scale;
+        denoisers.push_back(createVideoDenoiser(strength, options));
+    }
+
+    std::vector<double> seconds(denoisers.size(), 0.0);
+    std::vector<double> cleanPsnr(denoisers.size(), 0.0);
+    std::vector<double> fullPsnr(denoisers.size(), 0.0);
+    cv::Mat clean;
+    cv::Mat noisy;
+    cv::Mat reference;
+    cv::Mat output;
+    for (int i = 0; i < frames; i++) {
+        clip.render(i, clean, noisy);
+        for (size_t k = 0; k < denoisers.size(); k++) {
+            cv::Mat& target = (k == 0) ? reference : output;
+            auto start = std::chrono::steady_clock::now();
+            denoisers[k]->denoise(noisy, target);
+            seconds[k] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            cleanPsnr[k] += cv::PSNR(target, clean);
+            if (k > 0) {
+                fullPsnr[k] += cv::PSNR(target, reference);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < denoisers.size(); k++) {
+        std::string name = (k == 0) ? std::string("full") : "1/" + std::to_string(scales[k - 1]);
+        std::cout << std::setw(10) << name
+                  << std::setw(12) << std::fixed << std::setprecision(2) << seconds[k] * 1000.0 / frames
+                  << std::setw(10) << seconds[0] / seconds[k]
+                  << std::setw(12) << cleanPsnr[k] / frames;
+        if (k > 0) {
+            std::cout << std::setw(12) << fullPsnr[k] / frames;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+static int runYuvBench(int width, int height, int frames, float strength, double noiseSigma) {
+    if (width % 2 != 0 || height % 2 != 0) {
+        std::cerr << "Error: The yuv benchmark needs an even frame size" << std::endl;
+        return 1;
+    }
+    SyntheticClip clip(width, height, noiseSigma);
+
+    std::cout << "BGR round trip vs planar YUV, " << frames << " frames at " << width << "x" << height
+              << ", strength " << strength << std::endl;
+    std::cout << std::setw(10) << "path" << std::setw(12) << "ms/frame" << std::setw(10) << "speedup"
+              << std::setw(12) << "PSNR clean" << std::endl;
+
+    // Quality is compared without the brightness/contrast stage
+    VideoDenoiserOptions options;
+    options.contrast = 1.0;
+    options.brightness = 0.0;
+    std::unique_ptr<VideoDenoiser> bgrDenoiser = createVideoDenoiser(strength, options);
+    options.planarYuv = true;
+    std::unique_ptr<VideoDenoiser> planarDenoiser = createVideoDenoiser(strength, options);
+
+    double bgrSeconds = 0.0;
+    double planarSeconds = 0.0;
+    double bgrPsnr = 0.0;
+    double planarPsnr = 0.0;
+    cv::Mat clean;
+    cv::Mat noisy;
+    cv::Mat cleanYuv;
+    cv::Mat noisyYuv;
+    cv::Mat bgr;
+    cv::Mat denoisedBgr;
+    cv::Mat output;
+    for (int i = 0; i < frames; i++) {
+        // The clip is stored as I420, as the decoder would deliver it
+        clip.render(i, clean, noisy);
+        cv::cvtColor(clean, cleanYuv, cv::COLOR_BGR2YUV_I420);
+        cv::cvtColor(noisy, noisyYuv, cv::COLOR_BGR2YUV_I420);
+
+        // BGR pipeline: convert for the denoiser, then back for the encoder
+        auto start = std::chrono::steady_clock::now();
+        cv::cvtColor(noisyYuv, bgr, cv::COLOR_YUV2BGR_I420);
+        bgrDenoiser->denoise(bgr, denoisedBgr);
+        cv::cvtColor(denoisedBgr, output, cv::COLOR_BGR2YUV_I420);
+        bgrSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bgrPsnr += cv::PSNR(output, cleanYuv);
+
+        start = std::chrono::steady_clock::now();
+        planarDenoiser->denoise(noisyYuv, output);
+        planarSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        planarPsnr += cv::PSNR(output, cleanYuv);
+    }
+
+    std::cout << std::setw(10) << "bgr"
+              << std::setw(12) << std::fixed << std::setprecision(2) << bgrSeconds * 1000.0 / frames
+              << std::setw(10) << 1.0
+              << std::setw(12) << bgrPsnr / frames << std::endl;
+    std::cout << std::setw(10) << "yuv420"
+              << std::setw(12) << planarSeconds * 1000.0 / frames
+              << std::setw(10) << bgrSeconds / planarSeconds
+              << std::setw(12) << planarPsnr / frames << std::endl;
+    return 0;
+}
+
+static int runSkipBench(int width, int height, int frames, float strength, double noiseSigma,
+                        const std::vector<int>& thresholds) {
+    SyntheticClip clip(width, height, noiseSigma);
+
+    std::cout << "Change detection on a static shot, " << frames << " frames at " << width << "x" << height
+              << ", strength " << strength << ", noise " << noiseSigma << std::endl;
+    std::cout << std::setw(10) << "threshold" << std::setw(12) << "ms/frame" << std::setw(10) << "speedup"
+              << std::setw(14) << "tiles skipped" << std::setw(12) << "PSNR full" << std::endl;
+
+    VideoDenoiserOptions options;
+    std::vector<std::unique_ptr<VideoDenoiser>> denoisers;
+    denoisers.push_back(createVideoDenoiser(strength, options));
+    for (int threshold : thresholds) {
+        options.skipThreshold = threshold;
+        denoisers.push_back(createVideoDenoiser(strength, options));
+    }
+
+    std::vector<double> seconds(denoisers.size(), 0.0);
+    std::vector<double> fullPsnr(denoisers.size(), 0.0);
+    cv::Mat clean;
+    cv::Mat noisy;
+    cv::Mat reference;
+    cv::Mat output;
+    for (int i = 0; i < frames; i++) {
+        clip.render(i, clean, noisy);
+        for (size_t k = 0; k < denoisers.size(); k++) {
+            cv::Mat& target = (k == 0) ? reference : output;
+            auto start = std::chrono::steady_clock::now();
+            denoisers[k]->denoise(noisy, target);
+            seconds[k] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (k > 0) {
+                fullPsnr[k] += std::min(cv::PSNR(target, reference), 100.0);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < denoisers.size(); k++) {
+        SkipStats stats = denoisers[k]->skipStats();
+        double skipped = stats.tiles > 0 ? 100.0 * stats.skippedTiles / stats.tiles : 0.0;
+        std::cout << std::setw(10) << ((k == 0) ? std::string("off") : std::to_string(thresholds[k - 1]))
+                  << std::setw(12) << std::fixed << std::setprecision(2) << seconds[k] * 1000.0 / frames
+                  << std::setw(10) << seconds[0] / seconds[k]
+                  << std::setw(13) << std::setprecision(1) << skipped << "%";
+        if (k > 0) {
+            std::cout << std::setw(12) << std::setprecision(2) << fullPsnr[k] / frames;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * Mean structural similarity over all channels (11x11 Gaussian window, sigma 1.5)
+ * @param first First image
+ * @param second Second image, same size and type
+ * @return SSIM in [-1, 1], 1 for identical images
+ */
+static double computeSsim(const cv::Mat& first, const cv::Mat& second) {
+    const double c1 = 6.5025;    // (0.01 * 255)^2
+    const double c2 = 58.5225;   // (0.03 * 255)^2
+    const cv::Size window(11, 11);
+
+    cv::Mat x;
+    cv::Mat y;
+    first.convertTo(x, CV_32F);
+    second.convertTo(y, CV_32F);
+
+    cv::Mat xx;
+    cv::Mat yy;
+    cv::Mat xy;
+    cv::multiply(x, x, xx);
+    cv::multiply(y, y, yy);
+    cv::multiply(x, y, xy);
+
+    cv::Mat muX;
+    cv::Mat muY;
+    cv::GaussianBlur(x, muX, window, 1.5);
+    cv::GaussianBlur(y, muY, window, 1.5);
+    cv::Mat muXX;
+    cv::Mat muYY;
+    cv::Mat muXY;
+    cv::multiply(muX, muX, muXX);
+    cv::multiply(muY, muY, muYY);
+    cv::multiply(muX, muY, muXY);
+
+    cv::Mat sigmaXX;
+    cv::Mat sigmaYY;
+    cv::Mat sigmaXY;
+    cv::GaussianBlur(xx, sigmaXX, window, 1.5);
+    cv::GaussianBlur(yy, sigmaYY, window, 1.5);
+    cv::GaussianBlur(xy, sigmaXY, window, 1.5);
+    cv::subtract(sigmaXX, muXX, sigmaXX);
+    cv::subtract(sigmaYY, muYY, sigmaYY);
+    cv::subtract(sigmaXY, muXY, sigmaXY);
+
+    // (2 muX muY + c1)(2 sigmaXY + c2) / ((muX^2 + muY^2 + c1)(sigmaX^2 + sigmaY^2 + c2))
+    cv::Mat numerator;
+    cv::Mat numeratorRight;
+    muXY.convertTo(numerator, CV_32F, 2.0, c1);
+    sigmaXY.convertTo(numeratorRight, CV_32F, 2.0, c2);
+    cv::multiply(numerator, numeratorRight, numerator);
+
+    cv::Mat denominator;
+    cv::Mat denominatorRight;
+    cv::add(muXX, muYY, denominator);
+    cv::add(denominator, cv::Scalar::all(c1), denominator);
+    cv::add(sigmaXX, sigmaYY, denominatorRight);
+    cv::add(denominatorRight, cv::Scalar::all(c2), denominatorRight);
+    cv::multiply(denominator, denominatorRight, denominator);
+
+    cv::Mat ssimMap;
+    cv::divide(numerator, denominator, ssimMap);
+    cv::Scalar channelMeans = cv::mean(ssimMap);
+    double total = 0.0;
+    for (int c = 0; c < first.channels(); c++) {
+        total += channelMeans[c];
+    }
+    return total / first.channels();
+}
+
+/**
+ * Gets a percentile by nearest rank
+ * @param values Samples, reordered in place
+ * @param fraction Percentile as a fraction, e.g. 0.99
+ * @return Percentile value, or 0 without samples
+ */
+static double percentile(std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(fraction * values.size()));
+    size_t index = std::min(values.size() - 1, rank > 0 ? rank - 1 : 0);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+/**
+ * Gets the 16:9 frame width for a frame height, rounded to an even number
+ * @param height Frame height
+ * @return Frame width
+ */
+static int widthFor(int height) {
+    return (height * 16 / 9 + 1) & ~1;
+}
+
+/**
+ * Names the CPUVideoDenoiser path a strength selects
+ * @param strength Denoising strength
+ * @return Band name
+ */
+static const char* strengthBand(int strength) {
+    return strength < 33 ? "nlm" : (strength < 66 ? "bilateral" : "bilat+nlm");
+}
+
+static void printLatencyHeader(const std::string& firstColumn) {
+    std::cout << std::setw(8) << "size" << std::setw(10) << firstColumn << std::setw(11) << "band"
+              << std::setw(9) << "fps" << std::setw(9) << "p50 ms" << std::setw(9) << "p90 ms"
+              << std::setw(9) << "p99 ms" << std::setw(9) << "max ms" << std::setw(10) << "PSNR in"
+              << std::setw(10) << "PSNR out" << std::setw(9) << "SSIM in" << std::setw(10) << "SSIM out" << std::endl;
+}
+
+static void printLatencyRow(int height, int strength, double fps, std::vector<double>& latenciesMs,
+                            double psnrIn, double psnrOut, double ssimIn, double ssimOut) {
+    double p50 = percentile(latenciesMs, 0.50);
+    double p90 = percentile(latenciesMs, 0.90);
+    double p99 = percentile(latenciesMs, 0.99);
+    double worst = percentile(latenciesMs, 1.0);
+    std::cout << std::setw(8) << (std::to_string(height) + "p") << std::setw(10) << strength
+              << std::setw(11) << strengthBand(strength)
+              << std::setw(9) << std::fixed << std::setprecision(1) << fps
+              << std::setw(9) << p50 << std::setw(9) << p90 << std::setw(9) << p99 << std::setw(9) << worst
+              << std::setw(10) << std::setprecision(2) << psnrIn << std::setw(10) << psnrOut
+              << std::setw(9) << std::setprecision(4) << ssimIn << std::setw(10) << ssimOut << std::endl;
+}
+
+static int runBandBench(const std::vector<int>& heights, int frames, const std::vector<int>& strengths,
+                        double noiseSigma) {
+    std::cout << "CPUVideoDenoiser strength bands in isolation, " << frames << " frames per run, noise sigma "
+              << noiseSigma << std::endl;
+    printLatencyHeader("strength");
+
+    // Quality is compared with the clean clip, so the brightness/contrast stage stays off
+    VideoDenoiserOptions options;
+    options.contrast = 1.0;
+    options.brightness = 0.0;
+
+    for (int height : heights) {
+        const int width = widthFor(height);
+        SyntheticClip clip(width, height, noiseSigma);
+        for (int strength : strengths) {
+            std::unique_ptr<VideoDenoiser> denoiser = createVideoDenoiser(static_cast<float>(strength), options);
+            denoiser->initialize(width, height);
+
+            std::vector<double> latenciesMs;
+            double totalSeconds = 0.0;
+            double psnrIn = 0.0;
+            double psnrOut = 0.0;
+            double ssimIn = 0.0;
+            double ssimOut = 0.0;
+            cv::Mat clean;
+            cv::Mat noisy;
+            cv::Mat output;
+            for (int i = 0; i < frames; i++) {
+                clip.render(i, clean, noisy);
+                auto start = std::chrono::steady_clock::now();
+                denoiser->denoise(noisy, output);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                totalSeconds += seconds;
+                latenciesMs.push_back(seconds * 1000.0);
+
+                psnrIn += cv::PSNR(noisy, clean);
+                psnrOut += cv::PSNR(output, clean);
+                ssimIn += computeSsim(noisy, clean);
+                ssimOut += computeSsim(output, clean);
+            }
+            printLatencyRow(height, strength, frames / totalSeconds, latenciesMs, psnrIn / frames,
+                            psnrOut / frames, ssimIn / frames, ssimOut / frames);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Writes the noisy clip to a file, losslessly when the OpenCV build has FFV1
+ * @param clip Clip generator
+ * @param directory Output directory
+ * @param width Frame width
+ * @param height Frame height
+ * @param frames Number of frames
+ * @return Path of the written clip, or empty on failure
+ */
+static std::string writeClip(const SyntheticClip& clip, const std::string& directory, int width, int height,
+                             int frames) {
+    const double fps = 30.0;
+    std::string path = directory + "/clip_" + std::to_string(height) + "p.mkv";
+    cv::VideoWriter writer;
+    if (!writer.open(path, cv::VideoWriter::fourcc('F', 'F', 'V', '1'), fps, cv::Size(width, height))) {
+        std::cerr << "Warning: FFV1 unavailable, writing MJPEG; input PSNR includes JPEG loss" << std::endl;
+        path = directory + "/clip_" + std::to_string(height) + "p.avi";
+        if (!writer.open(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, cv::Size(width, height))) {
+            std::cerr << "Could not create test clip " << path << std::endl;
+            return std::string();
+        }
+    }
+
+    cv::Mat clean;
+    cv::Mat noisy;
+    for (int i = 0; i < frames; i++) {
+        clip.render(i, clean, noisy);
+        writer.write(noisy);
+    }
+    writer.release();
+    return path;
+}
+
+/**
+ * Compares a video file frame by frame with the clean clip
+ * @param path Video to read
+ * @param clip Clip generator
+ * @param frames Number of frames expected
+ * @param psnr Receives the mean PSNR
+ * @param ssim Receives the mean SSIM
+ * @return True if every frame could be read
+ */
+static bool measureQuality(const std::string& path, const SyntheticClip& clip, int frames, double& psnr,
+                           double& ssim) {
+    cv::VideoCapture capture(path);
+    psnr = 0.0;
+    ssim = 0.0;
+    cv::Mat decoded;
+    cv::Mat clean;
+    cv::Mat noisy;
+    for (int i = 0; i < frames; i++) {
+        if (!capture.read(decoded)) {
+            std::cerr << "Could only read " << i << " of " << frames << " frames from " << path << std::endl;
+            return false;
+        }
+        clip.render(i, clean, noisy);
+        psnr += cv::PSNR(decoded, clean);
+        ssim += computeSsim(decoded, clean);
+    }
+    psnr /= frames;
+    ssim /= frames;
+    return true;
+}
+
+static int runEndToEndBench(const std::vector<int>& heights, int frames, const std::vector<int>& strengths,
+                            double noiseSigma, int numThreads, const std::string& directory) {
+    std::filesystem::create_directories(directory);
+
+    // The denoisers run with brightness/contrast off so the output can be compared with the clean clip
+    VideoDenoiserOptions options;
+    options.contrast = 1.0;
+    options.brightness = 0.0;
+
+    struct Row {
+        int height;
+        int strength;
+        double fps;
+        std::vector<double> latenciesMs;
+        double psnrIn, psnrOut, ssimIn, ssimOut;
+    };
+    std::vector<Row> rows;
+
+    for (int height : heights) {
+        const int width = widthFor(height);
+        SyntheticClip clip(width, height, noiseSigma);
+        std::string clipPath = writeClip(clip, directory, width, height, frames);
+        if (clipPath.empty()) {
+            return 1;
+        }
+
+        double psnrIn = 0.0;
+        double ssimIn = 0.0;
+        if (!measureQuality(clipPath, clip, frames, psnrIn, ssimIn)) {
+            return 1;
+        }
+
+        for (int strength : strengths) {
+            std::string outputPath = directory + "/out_" + std::to_string(height) + "p_s" +
+                                     std::to_string(strength) + ".mp4";
+            VideoProcessor processor(100.0f, 8000.0f, 0.5f, static_cast<float>(strength), numThreads, options);
+            processor.setRecordLatencies(true);
+
+            auto start = std::chrono::steady_clock::now();
+            if (!processor.processVideo(clipPath, outputPath)) {
+                std::cerr << "End-to-end run failed for " << clipPath << std::endl;
+                return 1;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            Row row;
+            row.height = height;
+            row.strength = strength;
+            row.fps = frames / seconds;
+            for (double latency : processor.frameLatencies()) {
+                row.latenciesMs.push_back(latency * 1000.0);
+            }
+            row.psnrIn = psnrIn;
+            row.ssimIn = ssimIn;
+            if (!measureQuality(outputPath, clip, frames, row.psnrOut, row.ssimOut)) {
+                return 1;
+            }
+            rows.push_back(std::move(row));
+        }
+    }
+
+    // The processor logs as it goes, so the table comes after all runs
+    std::cout << std::endl << "End to end (decode, denoise, encode, mux), " << frames << " frames per run, "
+              << numThreads << " worker(s); latency is decode to encoded" << std::endl;
+    printLatencyHeader("strength");
+    for (Row& row : rows) {
+        printLatencyRow(row.height, row.strength, row.fps, row.latenciesMs, row.psnrIn, row.psnrOut, row.ssimIn,
+                        row.ssimOut);
+    }
+    return 0;
+}
+
+/**
+ * Counts the frames that differ between two video files
+ * @param firstPath First video
+ * @param secondPath Second video
+ * @param frames Number of frames expected in each
+ * @return Number of differing frames, or -1 if a file could not be read
+ */
+static int countDifferingFrames(const std::string& firstPath, const std::string& secondPath, int frames) {
+    cv::VideoCapture first(firstPath);
+    cv::VideoCapture second(secondPath);
+    cv::Mat firstFrame;
+    cv::Mat secondFrame;
+    int differing = 0;
+    for (int i = 0; i < frames; i++) {
+        if (!first.read(firstFrame) || !second.read(secondFrame)) {
+            std::cerr << "Could only read " << i << " of " << frames << " frames" << std::endl;
+            return -1;
+        }
+        if (firstFrame.size() != secondFrame.size() || cv::norm(firstFrame, secondFrame, cv::NORM_INF) != 0) {
+            differing++;
+        }
+    }
+    return differing;
+}
+
+static int runOrderCheck(const std::vector<int>& heights, int frames, float strength, double noiseSigma,
+                         const std::vector<int>& thresholds, int numThreads, const std::string& directory) {
+    if (numThreads < 2) {
+        std::cerr << "Error: order needs --threads above 1" << std::endl;
+        return 1;
+    }
+    std::filesystem::create_directories(directory);
+
+    std::cout << "Sequential vs " << numThreads << " worker(s) with change detection, " << frames
+              << " frames per run" << std::endl;
+    bool allEqual = true;
+    for (int height : heights) {
+        const int width = widthFor(height);
+        SyntheticClip clip(width, height, noiseSigma);
+        std::string clipPath = writeClip(clip, directory, width, height, frames);
+        if (clipPath.empty()) {
+            return 1;
+        }
+
+        for (int threshold : thresholds) {
+            VideoDenoiserOptions options;
+            options.skipThreshold = threshold;
+
+            std::string prefix = directory + "/order_" + std::to_string(height) + "p_t" + std::to_string(threshold);
+            std::string sequentialPath = prefix + "_sequential.mp4";
+            std::string threadedPath = prefix + "_threaded.mp4";
+            VideoProcessor sequential(100.0f, 8000.0f, 0.5f, strength, 1, options);
+            VideoProcessor threaded(100.0f, 8000.0f, 0.5f, strength, numThreads, options);
+            if (!sequential.processVideo(clipPath, sequentialPath) || !threaded.processVideo(clipPath, threadedPath)) {
+                std::cerr << "Order check run failed for " << clipPath << std::endl;
+                return 1;
+            }
+
+            int differing = countDifferingFrames(sequentialPath, threadedPath, frames);
+            if (differing < 0) {
+                return 1;
+            }
+            std::cout << std::setw(8) << (std::to_string(height) + "p") << "  threshold " << threshold << ": "
+                      << (differing == 0 ? "identical" : std::to_string(differing) + " frame(s) differ")
+                      << std::endl;
+            allEqual = allEqual && differing == 0;
+        }
+    }
+    return allEqual ? 0 : 1;
+}
+
+static void printUsage(const char* programName) {
+    std::cout << "Video Cleaner video pipeline benchmarks" << std::endl;
+    std::cout << "Usage: " << programName << " <denoisers|pool|enhance|tiles|preview|yuv|skip|bands|e2e|order> [options]" << std::endl;
+    std::cout << "Benchmarks:" << std::endl;
+    std::cout << "  denoisers           : Spatial vs temporal denoiser speed and quality" << std::endl;
+    std::cout << "  pool                : Frame loop with fresh vs pooled frame buffers" << std::endl;
+    std::cout << "  enhance             : Brightness/contrast as a separate pass vs fused into the denoiser" << std::endl;
+    std::cout << "  tiles               : Whole-frame vs tiled NLM at 1080p, 4K and 8K" << std::endl;
+    std::cout << "  preview             : Full-resolution vs preview (downscaled luma) denoising" << std::endl;
+    std::cout << "  yuv                 : BGR round trip vs planar YUV 4:2:0 denoising" << std::endl;
+    std::cout << "  skip                : Full denoising vs change detection at several skip thresholds" << std::endl;
+    std::cout << "  bands               : Each spatial strength band alone: fps, latency percentiles, PSNR/SSIM" << std::endl;
+    std::cout << "  e2e                 : Generated clip files through the whole VideoProcessor pipeline" << std::endl;
+    std::cout << "  order               : Checks that --threads output matches sequential output with change detection" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --width <px>        : Frame width (default: 1920)" << std::endl;
+    std::cout << "  --height <px>       : Frame height (default: 1080)" << std::endl;
+    std::cout << "  --frames <n>        : Frames per run (default: 60)" << std::endl;
+    std::cout << "  --strength <0-100>  : Denoising strength (default: 10)" << std::endl;
+    std::cout << "  --noise <sigma>     : Gaussian noise added to the clip (default: 10)" << std::endl;
+    std::cout << "  --window <n,n,...>  : Temporal window sizes to compare (default: 3,5,8)" << std::endl;
+    std::cout << "  --tiles <n,n,...>   : Tile sizes for tiles (default: 128,256,512)" << std::endl;
+    std::cout << "  --scales <n,n,...>  : Downscale factors for preview (default: 2,3)" << std::endl;
+    std::cout << "  --thresholds <n,...>: Skip thresholds for skip and order (default: 2,4,8)" << std::endl;
+    std::cout << "  --sizes <h,h,...>   : 16:9 frame heights for bands, e2e and order (default: 480,1080,2160)" << std::endl;
+    std::cout << "  --strengths <n,...> : Strengths for bands and e2e, one per band (default: 20,50,80)" << std::endl;
+    std::cout << "  --threads <n>       : Frame workers for e2e and order (default: 1)" << std::endl;
+    std::cout << "  --dir <path>        : Where e2e and order write their clips and outputs (default: bench_clips)" << std::endl;
+}
+
+static std::vector<int> parseList(const std::string& text) {
+    std::vector<int> values;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = text.size();
+        }
+        values.push_back(std::stoi(text.substr(pos, comma - pos)));
+        pos = comma + 1;
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+        printUsage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+
+    std::string mode = argv[1];
+    int width = 1920;
+    int height = 1080;
+    int frames = 60;
+    float strength = 10.0f;
+    double noiseSigma = 10.0;
+    std::vector<int> windows = {3, 5, 8};
+    std::vector<int> tileSizes = {128, 256, 512};
+    std::vector<int> scales = {2, 3};
+    std::vector<int> thresholds = {2, 4, 8};
+    std::vector<int> sizes = {480, 1080, 2160};
+    std::vector<int> strengths = {20, 50, 80};
+    int numThreads = 1;
+    std::string directory = "bench_clips";
+
+    try {
+        int argIdx = 2;
+        while (argIdx < argc) {
+            if (strcmp(argv[argIdx], "--width") == 0 && argIdx + 1 < argc) {
+                width = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--height") == 0 && argIdx + 1 < argc) {
+                height = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--frames") == 0 && argIdx + 1 < argc) {
+                frames = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--strength") == 0 && argIdx + 1 < argc) {
+                strength = std::stof(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--noise") == 0 && argIdx + 1 < argc) {
+                noiseSigma = std::stod(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--window") == 0 && argIdx + 1 < argc) {
+                windows = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--tiles") == 0 && argIdx + 1 < argc) {
+                tileSizes = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--scales") == 0 && argIdx + 1 < argc) {
+                scales = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--thresholds") == 0 && argIdx + 1 < argc) {
+                thresholds = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--sizes") == 0 && argIdx + 1 < argc) {
+                sizes = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--strengths") == 0 && argIdx + 1 < argc) {
+                strengths = parseList(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--threads") == 0 && argIdx + 1 < argc) {
+                numThreads = std::stoi(argv[argIdx + 1]);
+                argIdx += 2;
+            } else if (strcmp(argv[argIdx], "--dir") == 0 && argIdx + 1 < argc) {
+                directory = argv[argIdx + 1];
+                argIdx += 2;
+            } else {
+                std::cerr << "Unexpected argument: " << argv[argIdx] << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (width <= 0 || height <= 0 || frames <= 0 || strength < 0 || noiseSigma < 0) {
+            std::cerr << "Error: Benchmark parameters must be positive" << std::endl;
+            return 1;
+        }
+
+        if (mode == "denoisers") {
+            return runDenoiserBench(width, height, frames, strength, noiseSigma, windows);
+        }
+        if (mode == "pool") {
+            return runPoolBench(width, height, frames, strength, noiseSigma);
+        }
+        if (mode == "enhance") {
+            return runEnhanceBench(width, height, frames, strength, noiseSigma);
+        }
+        if (mode == "tiles") {
+            return runTileBench(frames, strength, noiseSigma, tileSizes);
+        }
+        if (mode == "preview") {
+            return runPreviewBench(width, height, frames, strength, noiseSigma, scales);
+        }
+        if (mode == "yuv") {
+            return runYuvBench(width, height, frames, strength, noiseSigma);
+        }
+        if (mode == "skip") {
+            return runSkipBench(width, height, frames, strength, noiseSigma, thresholds);
+        }
+        if (mode == "bands" || mode == "e2e" || mode == "order") {
+            for (int size : sizes) {
+                if (size < 16) {
+                    std::cerr << "Error: Frame heights must be at least 16" << std::endl;
+                    return 1;
+                }
+            }
+            for (int value : strengths) {
+                if (value < 0 || value > 100) {
+                    std::cerr << "Error: Strengths must be between 0 and 100" << std::endl;
+                    return 1;
+                }
+            }
+            if (numThreads < 1) {
+                std::cerr << "Error: Thread count must be at least 1" << std::endl;
+                return 1;
+            }
+            if (mode == "order") {
+                return runOrderCheck(sizes, frames, strength, noiseSigma, thresholds, numThreads, directory);
+            }
+            return mode == "bands"
+                ? runBandBench(sizes, frames, strengths, noiseSigma)
+                : runEndToEndBench(sizes, frames, strengths, noiseSigma, numThreads, directory);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Unknown benchmark: " << mode << std::endl;
+    printUsage(argv[0]);
+    return 1;
+}
@@ -1,13 +1,92 @@
 #include "video_denoise.h"
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
 
-std::unique_ptr<VideoDenoiser> createVideoDenoiser(float strength) {
-    return std::make_unique<CPUVideoDenoiser>(strength);
+constexpr int kMaxTemporalWindow = 16;
+
+// Rows filtered per strip before enhancing; a 4K strip of 32 rows stays in L2
+constexpr int kEnhanceStripRows = 32;
+
+constexpr int kNlmTemplateWindow = 7;
+
+// Guided filter window at preview resolution
+constexpr int kGuidedRadius = 2;
+
+// Change detection tile edge, and the halo re-denoised bands carry: enough for
+// NLM with the largest search window (17 + 3) after the bilateral prefilter
+constexpr int kChangeTileSize = 64;
+constexpr int kChangeHalo = 24;
+
+std::unique_ptr<VideoDenoiser> createVideoDenoiser(float strength, const VideoDenoiserOptions& options) {
+    if (options.planarYuv && options.preview) {
+        throw std::invalid_argument("Preview mode works on BGR frames and cannot be combined with planar YUV");
+    }
+    if (options.skipThreshold >= 0 && options.backend == DenoiserBackend::Temporal) {
+        throw std::invalid_argument("Change skipping needs the spatial denoiser; temporal output depends on every frame");
+    }
+    if (options.skipThreshold >= 0 && options.preview) {
+        // Preview denoising of a band depends on the band's position in the
+        // downscale grid and reaches further than kChangeHalo full-size pixels
+        throw std::invalid_argument("Change skipping cannot be combined with preview mode");
+    }
+
+    std::unique_ptr<VideoDenoiser> denoiser;
+    if (options.planarYuv) {
+        // The enhancement is set per plane by PlanarVideoDenoiser::setEnhancement,
+        // and each plane gets its own change detection
+        VideoDenoiserOptions planeOptions = options;
+        planeOptions.planarYuv = false;
+        denoiser = std::make_unique<PlanarVideoDenoiser>(strength, createVideoDenoiser(strength, planeOptions),
+                                                         createVideoDenoiser(strength, planeOptions),
+                                                         createVideoDenoiser(strength, planeOptions));
+    } else if (options.preview) {
+        // The wrapped denoiser sees only the small luma plane; the enhancement
+        // belongs on the final full-size frame
+        VideoDenoiserOptions innerOptions = options;
+        innerOptions.preview = false;
+        innerOptions.skipThreshold = -1.0;
+        innerOptions.contrast = 1.0;
+        innerOptions.brightness = 0.0;
+        denoiser = std::make_unique<PreviewVideoDenoiser>(strength, createVideoDenoiser(strength, innerOptions),
+                                                          options.previewScale);
+    } else if (options.backend == DenoiserBackend::Temporal) {
+        denoiser = std::make_unique<TemporalVideoDenoiser>(strength, options.temporalWindow);
+    } else {
+        denoiser = std::make_unique<CPUVideoDenoiser>(strength, options.tileSize);
+    }
+
+    if (options.skipThreshold >= 0 && !options.planarYuv) {
+        denoiser = std::make_unique<ChangeSkippingVideoDenoiser>(strength, std::move(denoiser), options.skipThreshold);
+    }
+    denoiser->setEnhancement(options.contrast, options.brightness);
+    return denoiser;
+}
+
+void VideoDenoiser::setEnhancement(double alpha, double beta) {
+    if (alpha == 1.0 && beta == 0.0) {
+        m_enhanceTable.release();
+        return;
+    }
+
+    // Same rounding and clamping as convertTo(frame, -1, alpha, beta)
+    m_enhanceTable.create(1, 256, CV_8U);
+    uchar* table = m_enhanceTable.ptr<uchar>();
+    for (int v = 0; v < 256; v++) {
+        table[v] = cv::saturate_cast<uchar>(v * alpha + beta);
+    }
+}
+
+void VideoDenoiser::applyEnhancement(cv::Mat& frame) const {
+    if (!m_enhanceTable.empty()) {
+        cv::LUT(frame, m_enhanceTable, frame);
+    }
 }
 
-CPUVideoDenoiser::CPUVideoDenoiser(float strength)
-    : VideoDenoiser(strength), m_initialized(false) {
+CPUVideoDenoiser::CPUVideoDenoiser(float strength, int tileSize)
+    : VideoDenoiser(strength), m_initialized(false), m_tileSize(std::max(0, tileSize)) {
 }
 
 CPUVideoDenoiser::~CPUVideoDenoiser() {
@@ -19,22 +98,444 @@ void CPUVideoDenoiser::initialize(int width, int height) {
     m_initialized = true;
 }
 
-cv::Mat CPUVideoDenoiser::denoise(const cv::Mat& inputFrame) {
+void CPUVideoDenoiser::denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) {
     if (!m_initialized) {
         initialize(inputFrame.cols, inputFrame.rows);
     }
 
-    cv::Mat result;
-
+    // OpenCV writes into outputFrame's existing buffer when the size and type match.
+    // The bilateral filter runs per strip and fuses the enhancement.
     if (m_strength < 33.0f) {
-        cv::fastNlMeansDenoisingColored(inputFrame, result, 3.0f, 3.0f, 7, 21);
+        denoiseNlm(inputFrame, outputFrame, false, 3.0f, 21);
     } else if (m_strength < 66.0f) {
-        cv::bilateralFilter(inputFrame, result, 9, 75, 75);
+        if (m_enhanceTable.empty()) {
+            cv::bilateralFilter(inputFrame, outputFrame, 9, 75, 75);
+        } else {
+            bilateralEnhanced(inputFrame, outputFrame);
+        }
+    } else {
+        denoiseNlm(inputFrame, outputFrame, true, 5.0f, 35);
+    }
+}
+
+/**
+ * Runs the colour NLM on BGR frames and the single-plane NLM on luma-only frames
+ */
+static void runNlm(const cv::Mat& source, cv::Mat& destination, float h, int searchWindow) {
+    if (source.channels() == 1) {
+        cv::fastNlMeansDenoising(source, destination, h, kNlmTemplateWindow, searchWindow);
+    } else {
+        cv::fastNlMeansDenoisingColored(source, destination, h, h, kNlmTemplateWindow, searchWindow);
+    }
+}
+
+void CPUVideoDenoiser::denoiseNlm(const cv::Mat& inputFrame, cv::Mat& outputFrame, bool prefilter, float h,
+                                  int searchWindow) {
+    if (m_tileSize > 0 && (inputFrame.cols > m_tileSize || inputFrame.rows > m_tileSize)) {
+        denoiseNlmTiles(inputFrame, outputFrame, prefilter, h, searchWindow);
+        return;
+    }
+
+    // Whole-frame NLM works on its own Lab copy, so the enhancement needs a separate table pass
+    const cv::Mat* source = &inputFrame;
+    if (prefilter) {
+        cv::bilateralFilter(inputFrame, m_intermediate, 9, 100, 100);
+        source = &m_intermediate;
+    }
+    runNlm(*source, outputFrame, h, searchWindow);
+    applyEnhancement(outputFrame);
+}
+
+void CPUVideoDenoiser::denoiseNlmTiles(const cv::Mat& inputFrame, cv::Mat& outputFrame, bool prefilter, float h,
+                                       int searchWindow) const {
+    outputFrame.create(inputFrame.rows, inputFrame.cols, inputFrame.type());
+
+    // NLM reads at most this far from a pixel, so with this halo a tile's core
+    // comes out exactly as in a whole-frame call and there are no seams to blend
+    const int halo = searchWindow / 2 + kNlmTemplateWindow / 2;
+    const int tilesX = (inputFrame.cols + m_tileSize - 1) / m_tileSize;
+    const int tilesY = (inputFrame.rows + m_tileSize - 1) / m_tileSize;
+    const cv::Rect frameRect(0, 0, inputFrame.cols, inputFrame.rows);
+
+    cv::parallel_for_(cv::Range(0, tilesX * tilesY), [&](const cv::Range& range) {
+        cv::Mat filtered;
+        cv::Mat denoised;
+        for (int tile = range.start; tile < range.end; tile++) {
+            cv::Rect core((tile % tilesX) * m_tileSize, (tile / tilesX) * m_tileSize, m_tileSize, m_tileSize);
+            core &= frameRect;
+            cv::Rect region(core.x - halo, core.y - halo, core.width + 2 * halo, core.height + 2 * halo);
+            region &= frameRect;
+
+            // The region is a view, so the bilateral prefilter reads real
+            // neighbours at its edges and matches a whole-frame call
+            cv::Mat source = inputFrame(region);
+            if (prefilter) {
+                cv::bilateralFilter(source, filtered, 9, 100, 100);
+                source = filtered;
+            }
+            runNlm(source, denoised, h, searchWindow);
+
+            cv::Mat result = denoised(cv::Rect(core.x - region.x, core.y - region.y, core.width, core.height));
+            cv::Mat target = outputFrame(core);
+            if (m_enhanceTable.empty()) {
+                result.copyTo(target);
+            } else {
+                cv::LUT(result, m_enhanceTable, target);
+            }
+        }
+    });
+}
+
+void CPUVideoDenoiser::bilateralEnhanced(const cv::Mat& inputFrame, cv::Mat& outputFrame) const {
+    outputFrame.create(inputFrame.rows, inputFrame.cols, inputFrame.type());
+    const int strips = (inputFrame.rows + kEnhanceStripRows - 1) / kEnhanceStripRows;
+
+    cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+        cv::Mat filtered;
+        for (int strip = range.start; strip < range.end; strip++) {
+            int top = strip * kEnhanceStripRows;
+            int bottom = std::min(top + kEnhanceStripRows, inputFrame.rows);
+
+            // A row range is a view into the frame, so the filter reads the real
+            // neighbours across strip edges and matches a whole-frame call
+            cv::bilateralFilter(inputFrame.rowRange(top, bottom), filtered, 9, 75, 75);
+            cv::Mat target = outputFrame.rowRange(top, bottom);
+            cv::LUT(filtered, m_enhanceTable, target);
+        }
+    });
+}
+
+TemporalVideoDenoiser::TemporalVideoDenoiser(float strength, int windowSize)
+    : VideoDenoiser(strength), m_windowSize(windowSize) {
+    if (windowSize < 2 || windowSize > kMaxTemporalWindow) {
+        throw std::invalid_argument("Temporal window must be between 2 and " +
+                                    std::to_string(kMaxTemporalWindow) + " frames");
+    }
+
+    // Two noisy samples of a static pixel differ by sqrt(2) sigma on average, so
+    // ~2.5x the strength keeps nearly all of them; the cap limits ghosting on motion
+    m_threshold = std::min(64, 4 + static_cast<int>(strength * 2.5f));
+    m_history.resize(windowSize - 1);
+
+    // Fixed-point 1/n, so the per-subpixel mean needs no division
+    m_reciprocals.resize(windowSize + 1, 0);
+    for (int n = 1; n <= windowSize; n++) {
+        m_reciprocals[n] = (65536 + n / 2) / n;
+    }
+}
+
+TemporalVideoDenoiser::~TemporalVideoDenoiser() {
+}
+
+void TemporalVideoDenoiser::initialize(int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_nextSlot = 0;
+    m_historyFrames = 0;
+}
+
+void TemporalVideoDenoiser::denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) {
+    if (inputFrame.depth() != CV_8U) {
+        throw std::invalid_argument("Temporal denoiser expects 8-bit frames");
+    }
+    if (inputFrame.cols != m_width || inputFrame.rows != m_height) {
+        initialize(inputFrame.cols, inputFrame.rows);
+    }
+
+    outputFrame.create(inputFrame.rows, inputFrame.cols, inputFrame.type());
+    const int rowBytes = inputFrame.cols * inputFrame.channels();
+    const int historyFrames = static_cast<int>(m_historyFrames);
+    const unsigned threshold = static_cast<unsigned>(m_threshold);
+    const int* reciprocals = m_reciprocals.data();
+    const uchar* enhanceTable = m_enhanceTable.empty() ? nullptr : m_enhanceTable.ptr<uchar>();
+
+    cv::parallel_for_(cv::Range(0, inputFrame.rows), [&](const cv::Range& rows) {
+        // Row accumulators keep the inner loops free of cross-frame dependencies so they vectorize
+        std::vector<uint16_t> sums(rowBytes);
+        std::vector<uint16_t> counts(rowBytes);
+
+        for (int y = rows.start; y < rows.end; y++) {
+            const uchar* current = inputFrame.ptr<uchar>(y);
+            for (int i = 0; i < rowBytes; i++) {
+                sums[i] = current[i];
+                counts[i] = 1;
+            }
+
+            for (int k = 0; k < historyFrames; k++) {
+                const uchar* past = m_history[k].ptr<uchar>(y);
+                for (int i = 0; i < rowBytes; i++) {
+                    // |past - current| <= threshold, without a branch
+                    uint16_t similar = static_cast<unsigned>(past[i] - current[i] + m_threshold) <= 2 * threshold;
+                    sums[i] += similar * past[i];
+                    counts[i] += similar;
+                }
+            }
+
+            uchar* output = outputFrame.ptr<uchar>(y);
+            for (int i = 0; i < rowBytes; i++) {
+                output[i] = static_cast<uchar>((sums[i] * reciprocals[counts[i]] + 32768) >> 16);
+            }
+
+            // Enhance while the row is still in L1
+            if (enhanceTable) {
+                for (int i = 0; i < rowBytes; i++) {
+                    output[i] = enhanceTable[output[i]];
+                }
+            }
+        }
+    });
+
+    // The oldest frame is overwritten; copyTo reuses the slot's buffer
+    inputFrame.copyTo(m_history[m_nextSlot]);
+    m_nextSlot = (m_nextSlot + 1) % m_history.size();
+    m_historyFrames = std::min(m_historyFrames + 1, m_history.size());
+}
+
+PreviewVideoDenoiser::PreviewVideoDenoiser(float strength, std::unique_ptr<VideoDenoiser> inner, int scale)
+    : VideoDenoiser(strength), m_inner(std::move(inner)), m_scale(scale) {
+    if (scale < 2 || scale > 4) {
+        throw std::invalid_argument("Preview scale must be between 2 and 4");
+    }
+
+    // Keeps noise-level variance (about strength^2 / 4 after downscaling) from
+    // being mistaken for an edge by the guided filter
+    m_epsilon = std::max(4.0, 0.25 * strength * strength);
+}
+
+PreviewVideoDenoiser::~PreviewVideoDenoiser() {
+}
+
+void PreviewVideoDenoiser::initialize(int width, int height) {
+    m_smallSize = cv::Size(std::max(1, width / m_scale), std::max(1, height / m_scale));
+    m_inner->initialize(m_smallSize.width, m_smallSize.height);
+}
+
+void PreviewVideoDenoiser::denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) {
+    if (inputFrame.type() != CV_8UC3) {
+        throw std::invalid_argument("Preview denoiser expects 8-bit BGR frames");
+    }
+    cv::Size smallSize(std::max(1, inputFrame.cols / m_scale), std::max(1, inputFrame.rows / m_scale));
+    if (smallSize != m_smallSize) {
+        initialize(inputFrame.cols, inputFrame.rows);
+    }
+
+    cv::cvtColor(inputFrame, m_ycrcb, cv::COLOR_BGR2YCrCb);
+    cv::resize(m_ycrcb, m_smallYcrcb, m_smallSize, 0, 0, cv::INTER_AREA);
+    cv::extractChannel(m_smallYcrcb, m_smallLuma, 0);
+    m_inner->denoise(m_smallLuma, m_smallDenoised);
+
+    // Chroma is smoothed at the small size and only interpolated back; its
+    // luma channel is overwritten by the guided upsample
+    cv::blur(m_smallYcrcb, m_smallYcrcb, cv::Size(3, 3));
+    cv::resize(m_smallYcrcb, m_chroma, inputFrame.size(), 0, 0, cv::INTER_LINEAR);
+    guidedUpsample();
+
+    cv::cvtColor(m_chroma, outputFrame, cv::COLOR_YCrCb2BGR);
+    applyEnhancement(outputFrame);
+}
+
+void PreviewVideoDenoiser::guidedUpsample() {
+    // Fast guided filter: fit denoised = a * noisy + b over small windows at
+    // low resolution, then apply the upsampled a and b to the full-size luma.
+    // Flat areas get a near 0 (the local mean), edges a near 1 (the guide).
+    const cv::Size window(2 * kGuidedRadius + 1, 2 * kGuidedRadius + 1);
+    m_smallLuma.convertTo(m_guide, CV_32F);
+    m_smallDenoised.convertTo(m_target, CV_32F);
+
+    cv::boxFilter(m_guide, m_meanGuide, CV_32F, window);
+    cv::boxFilter(m_target, m_meanTarget, CV_32F, window);
+
+    // Covariance of guide and target
+    cv::multiply(m_guide, m_target, m_product);
+    cv::boxFilter(m_product, m_gain, CV_32F, window);
+    cv::multiply(m_meanGuide, m_meanTarget, m_product);
+    cv::subtract(m_gain, m_product, m_gain);
+
+    // Variance of the guide
+    cv::multiply(m_guide, m_guide, m_product);
+    cv::boxFilter(m_product, m_offset, CV_32F, window);
+    cv::multiply(m_meanGuide, m_meanGuide, m_product);
+    cv::subtract(m_offset, m_product, m_offset);
+    cv::add(m_offset, cv::Scalar::all(m_epsilon), m_offset);
+
+    // a = cov / (var + eps), b = mean(target) - a * mean(guide)
+    cv::divide(m_gain, m_offset, m_gain);
+    cv::multiply(m_gain, m_meanGuide, m_product);
+    cv::subtract(m_meanTarget, m_product, m_offset);
+
+    cv::boxFilter(m_gain, m_gain, CV_32F, window);
+    cv::boxFilter(m_offset, m_offset, CV_32F, window);
+    cv::resize(m_gain, m_fullGain, m_ycrcb.size(), 0, 0, cv::INTER_LINEAR);
+    cv::resize(m_offset, m_fullOffset, m_ycrcb.size(), 0, 0, cv::INTER_LINEAR);
+
+    // Reads the luma straight out of the interleaved YCrCb frames, so no
+    // full-size plane is split off or merged back
+    cv::parallel_for_(cv::Range(0, m_ycrcb.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++) {
+            const uchar* guide = m_ycrcb.ptr<uchar>(y);
+            const float* gain = m_fullGain.ptr<float>(y);
+            const float* offset = m_fullOffset.ptr<float>(y);
+            uchar* output = m_chroma.ptr<uchar>(y);
+            for (int x = 0; x < m_ycrcb.cols; x++) {
+                output[3 * x] = cv::saturate_cast<uchar>(gain[x] * guide[3 * x] + offset[x]);
+            }
+        }
+    });
+}
+
+PlanarVideoDenoiser::PlanarVideoDenoiser(float strength, std::unique_ptr<VideoDenoiser> luma,
+                                         std::unique_ptr<VideoDenoiser> blue, std::unique_ptr<VideoDenoiser> red)
+    : VideoDenoiser(strength) {
+    m_planes[0] = std::move(luma);
+    m_planes[1] = std::move(blue);
+    m_planes[2] = std::move(red);
+}
+
+PlanarVideoDenoiser::~PlanarVideoDenoiser() {
+}
+
+void PlanarVideoDenoiser::initialize(int width, int height) {
+    int lumaHeight = height * 2 / 3;
+    m_planes[0]->initialize(width, lumaHeight);
+    m_planes[1]->initialize(width / 2, lumaHeight / 2);
+    m_planes[2]->initialize(width / 2, lumaHeight / 2);
+}
+
+void PlanarVideoDenoiser::setEnhancement(double alpha, double beta) {
+    // BGR' = alpha * BGR + beta in BT.601 limited-range YCbCr: luma scales
+    // around black (16) and takes the offset, chroma scales around neutral (128)
+    m_planes[0]->setEnhancement(alpha, 16.0 * (1.0 - alpha) + beta * 219.0 / 255.0);
+    m_planes[1]->setEnhancement(alpha, 128.0 * (1.0 - alpha));
+    m_planes[2]->setEnhancement(alpha, 128.0 * (1.0 - alpha));
+}
+
+SkipStats PlanarVideoDenoiser::skipStats() const {
+    SkipStats stats = m_planes[0]->skipStats();
+    for (int plane = 1; plane < 3; plane++) {
+        SkipStats chroma = m_planes[plane]->skipStats();
+        stats.tiles += chroma.tiles;
+        stats.skippedTiles += chroma.skippedTiles;
+    }
+    return stats;
+}
+
+void PlanarVideoDenoiser::denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) {
+    if (inputFrame.type() != CV_8UC1 || inputFrame.rows % 3 != 0 || inputFrame.cols % 2 != 0 ||
+        !inputFrame.isContinuous()) {
+        throw std::invalid_argument("Planar denoiser expects continuous I420 frames with an even size");
+    }
+    outputFrame.create(inputFrame.rows, inputFrame.cols, CV_8UC1);
+
+    const int width = inputFrame.cols;
+    const int height = inputFrame.rows * 2 / 3;
+    const cv::Size planeSizes[3] = {cv::Size(width, height), cv::Size(width / 2, height / 2),
+                                    cv::Size(width / 2, height / 2)};
+    uchar* input = const_cast<uchar*>(inputFrame.ptr<uchar>());
+    uchar* output = outputFrame.ptr<uchar>();
+
+    size_t offset = 0;
+    for (int plane = 0; plane < 3; plane++) {
+        // Headers over the planes, so each denoiser reads and writes the I420 buffers directly
+        cv::Mat source(planeSizes[plane], CV_8UC1, input + offset);
+        cv::Mat target(planeSizes[plane], CV_8UC1, output + offset);
+        m_planes[plane]->denoise(source, target);
+        if (target.data != output + offset) {
+            throw std::logic_error("Plane denoiser replaced its output buffer");
+        }
+        offset += planeSizes[plane].area();
+    }
+}
+
+ChangeSkippingVideoDenoiser::ChangeSkippingVideoDenoiser(float strength, std::unique_ptr<VideoDenoiser> inner,
+                                                         double threshold)
+    : VideoDenoiser(strength), m_inner(std::move(inner)), m_threshold(threshold) {
+    if (m_inner->isTemporal()) {
+        throw std::invalid_argument("Change skipping needs a stateless denoiser");
+    }
+}
+
+ChangeSkippingVideoDenoiser::~ChangeSkippingVideoDenoiser() {
+}
+
+void ChangeSkippingVideoDenoiser::initialize(int width, int height) {
+    m_inner->initialize(width, height);
+    m_reference.release();
+    m_output.release();
+    m_stats = SkipStats();
+}
+
+void ChangeSkippingVideoDenoiser::denoise(const cv::Mat& inputFrame, cv::Mat& outputFrame) {
+    const int tilesX = (inputFrame.cols + kChangeTileSize - 1) / kChangeTileSize;
+    const int tilesY = (inputFrame.rows + kChangeTileSize - 1) / kChangeTileSize;
+    const int totalTiles = tilesX * tilesY;
+    const cv::Rect frameRect(0, 0, inputFrame.cols, inputFrame.rows);
+    m_stats.frames++;
+    m_stats.tiles += totalTiles;
+
+    if (m_reference.size() != inputFrame.size() || m_reference.type() != inputFrame.type()) {
+        m_inner->denoise(inputFrame, m_output);
+        inputFrame.copyTo(m_reference);
+        m_output.copyTo(outputFrame);
+        return;
+    }
+
+    // Mean absolute difference per tile; one read of two frames is cheap next to any denoiser
+    m_changed.assign(totalTiles, 0);
+    cv::parallel_for_(cv::Range(0, totalTiles), [&](const cv::Range& range) {
+        for (int tile = range.start; tile < range.end; tile++) {
+            cv::Rect rect((tile % tilesX) * kChangeTileSize, (tile / tilesX) * kChangeTileSize, kChangeTileSize,
+                          kChangeTileSize);
+            rect &= frameRect;
+            double difference = cv::norm(inputFrame(rect), m_reference(rect), cv::NORM_L1);
+            m_changed[tile] = difference / (static_cast<double>(rect.area()) * inputFrame.channels()) > m_threshold;
+        }
+    });
+
+    int changedTiles = 0;
+    for (uchar changed : m_changed) {
+        changedTiles += changed;
+    }
+
+    if (changedTiles == 0) {
+        m_stats.skippedFrames++;
+        m_stats.skippedTiles += totalTiles;
+    } else if (changedTiles * 2 > totalTiles) {
+        // Mostly changed: one whole-frame call beats many band calls
+        m_inner->denoise(inputFrame, m_output);
+        inputFrame.copyTo(m_reference);
     } else {
-        cv::Mat temp;
-        cv::bilateralFilter(inputFrame, temp, 9, 100, 100);
-        cv::fastNlMeansDenoisingColored(temp, result, 5.0f, 5.0f, 7, 35);
+        int denoisedTiles = 0;
+        for (int ty = 0; ty < tilesY; ty++) {
+            int first = tilesX;
+            int last = -1;
+            for (int tx = 0; tx < tilesX; tx++) {
+                if (m_changed[ty * tilesX + tx]) {
+                    first = std::min(first, tx);
+                    last = tx;
+                }
+            }
+            if (last < 0) {
+                continue;
+            }
+
+            // Tiles between changed ones in the same row are redone too, so each row costs one call
+            cv::Rect core(first * kChangeTileSize, ty * kChangeTileSize, (last - first + 1) * kChangeTileSize,
+                          kChangeTileSize);
+            core &= frameRect;
+            cv::Rect region(core.x - kChangeHalo, core.y - kChangeHalo, core.width + 2 * kChangeHalo,
+                            core.height + 2 * kChangeHalo);
+            region &= frameRect;
+
+            m_inner->denoise(inputFrame(region), m_band);
+            cv::Mat target = m_output(core);
+            m_band(cv::Rect(core.x - region.x, core.y - region.y, core.width, core.height)).copyTo(target);
+            cv::Mat reference = m_reference(core);
+            inputFrame(core).copyTo(reference);
+            denoisedTiles += last - first + 1;
+        }
+        m_stats.skippedTiles += totalTiles - denoisedTiles;
     }
 
-    return result;
-}
\ No newline at end of file
+    // The caller's buffer moves on down the pipeline, so the kept output is copied
+    m_output.copyTo(outputFrame);
+}